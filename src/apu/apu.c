@@ -3,7 +3,11 @@
 
 #include "../cpu/cpu.h"
 #include "../memory/memory.h"
+#include "../ppu/timeline.h"
+#include "blip.h"
+#include <math.h>
 #include <stdbool.h>
+#include <stdatomic.h>
 #include <string.h>
 
 typedef struct {
@@ -74,6 +78,14 @@ typedef struct {
   bool silence;
 } APU_DMC;
 
+// Channel indices for the synthesizer
+#define APU_CH_PULSE1 0
+#define APU_CH_PULSE2 1
+#define APU_CH_TRIANGLE 2
+#define APU_CH_NOISE 3
+#define APU_CH_DMC 4
+#define APU_CHANNELS 5
+
 typedef struct {
   APU_Pulse pulse1;
   APU_Pulse pulse2;
@@ -97,6 +109,15 @@ typedef struct {
 
   // APU cycle tracking (Pulse/Noise/DMC run at half CPU speed)
   bool apu_cycle;
+
+  // Band-limited output. Pulse, triangle and noise timers are run lazily:
+  // they only affect the sound, so they are caught up to the current cycle
+  // before anything that changes their state and at the end of each audio
+  // frame, stepping from one timer expiry to the next.
+  uint32_t frame_time;     // CPU cycles into the current audio frame
+  uint32_t synced;         // frame_time the lazy timers have reached
+  bool frame_apu_cycle;    // apu_cycle at frame_time 0
+  uint8_t level[APU_CHANNELS]; // Last output per channel, as synthesized
 } APU_State;
 
 static APU_State apu;
@@ -256,24 +277,49 @@ static const uint16_t frame_cycles_mode0[4] = {7457, 7456, 7458, 7458};
 static const uint16_t frame_cycles_mode1[5] = {7457, 7456, 7458, 7458, 7452};
 
 // Ring Buffer for Audio
-#define AUDIO_BUFFER_SIZE 8192 // Increased buffer size for safety
+// Single producer (the emulation thread) and single consumer (the SDL audio
+// callback). Indices run freely and are masked on access; each is written by
+// one side only, published with release and read with acquire, so the
+// samples copied in before a store are visible to the other side after its
+// load. The indices sit on separate cache lines to avoid false sharing.
+#define AUDIO_BUFFER_SIZE 8192 // Power of two
+#define AUDIO_BUFFER_MASK (AUDIO_BUFFER_SIZE - 1)
+#define AUDIO_CACHE_LINE 64
 static float audio_buffer[AUDIO_BUFFER_SIZE];
-static volatile int buffer_write_pos = 0;
-static volatile int buffer_read_pos =
-    0; // Explicitly volatile for thread safety in this simple lock-free usage
-
-// Basic lock-free capacity check
-// Full if (write + 1) % SIZE == read
-// Empty if write == read
-
-static void buffer_write(float sample) {
-  int next_pos = (buffer_write_pos + 1) % AUDIO_BUFFER_SIZE;
-  if (next_pos != buffer_read_pos) {
-    audio_buffer[buffer_write_pos] = sample;
-    buffer_write_pos = next_pos;
-  }
-  // Else: Buffer full, drop sample (better than overwriting or blocking in this
-  // context)
+typedef struct {
+  _Alignas(AUDIO_CACHE_LINE) atomic_uint value;
+} APU_RingIndex; // Padded to a whole cache line
+static APU_RingIndex buffer_write_pos;
+static APU_RingIndex buffer_read_pos;
+static atomic_int callback_samples; // Size of the device's last read
+
+static int buffer_fill(void) {
+  unsigned w =
+      atomic_load_explicit(&buffer_write_pos.value, memory_order_relaxed);
+  unsigned r =
+      atomic_load_explicit(&buffer_read_pos.value, memory_order_acquire);
+  return (int)(w - r);
+}
+
+// Append `count` samples; whatever does not fit is dropped (better than
+// overwriting or blocking in this context)
+static void buffer_write(const float *samples, int count) {
+  unsigned w =
+      atomic_load_explicit(&buffer_write_pos.value, memory_order_relaxed);
+  unsigned r =
+      atomic_load_explicit(&buffer_read_pos.value, memory_order_acquire);
+  unsigned space = AUDIO_BUFFER_SIZE - (w - r);
+  if ((unsigned)count > space)
+    count = (int)space;
+
+  unsigned start = w & AUDIO_BUFFER_MASK;
+  int first = AUDIO_BUFFER_SIZE - start;
+  if (first > count)
+    first = count;
+  memcpy(&audio_buffer[start], samples, first * sizeof(float));
+  memcpy(audio_buffer, samples + first, (count - first) * sizeof(float));
+  atomic_store_explicit(&buffer_write_pos.value, w + count,
+                        memory_order_release);
 }
 
 // ---------------------------
@@ -291,15 +337,17 @@ static uint8_t triangle_sequence[32] = {
     15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5,  4,  3,  2,  1,  0,
     0,  1,  2,  3,  4,  5,  6, 7, 8, 9, 10, 11, 12, 13, 14, 15};
 
-static uint8_t pulse_output(APU_Pulse *p) {
+// Volume while the channel sounds; 0 if it is silenced whatever the duty
+static uint8_t pulse_volume(APU_Pulse *p) {
   if (!p->enabled || p->length_counter == 0 || p->timer_period < 8)
     return 0;
   // if (p->sweep_forcing_silence) return 0; // TODO: Sweep
 
-  if (pulse_duty_table[p->duty][p->duty_pos]) {
-    return p->constant_volume ? p->volume : p->envelope_counter;
-  }
-  return 0;
+  return p->constant_volume ? p->volume : p->envelope_counter;
+}
+
+static uint8_t pulse_output(APU_Pulse *p) {
+  return pulse_duty_table[p->duty][p->duty_pos] ? pulse_volume(p) : 0;
 }
 
 static uint8_t triangle_output(APU_Triangle *t) {
@@ -309,13 +357,18 @@ static uint8_t triangle_output(APU_Triangle *t) {
   return triangle_sequence[t->seq_index];
 }
 
-static uint8_t noise_output(APU_Noise *n) {
+static uint8_t noise_volume(APU_Noise *n) {
   if (!n->enabled || n->length_counter == 0)
     return 0;
+
+  return n->constant_volume ? n->volume : n->envelope_counter;
+}
+
+static uint8_t noise_output(APU_Noise *n) {
   if (n->lfsr & 0x01) // Output is 0 if bit 0 is set ? No, volume if bit 0 is 0
     return 0;
 
-  return n->constant_volume ? n->volume : n->envelope_counter;
+  return noise_volume(n);
 }
 
 static uint8_t dmc_output(APU_DMC *d) { return d->output_level; }
@@ -323,19 +376,55 @@ static uint8_t dmc_output(APU_DMC *d) { return d->output_level; }
 // ---------------------------
 // Mixer
 // ---------------------------
-// Approximated linear mixing for simplicity, or look-up table
+// Approximated linear mixing:
 // output = pulse_out + tnd_out
 // pulse_out = 0.00752 * (pulse1 + pulse2)
 // tnd_out = 0.00851 * triangle + 0.00494 * noise + 0.00335 * dmc
+// Being linear, it is applied per channel to each level change, and the
+// band-limited synthesizer (blip.c) sums the weighted steps.
+static const float mix_weight[APU_CHANNELS] = {0.00752f, 0.00752f, 0.00851f,
+                                               0.00494f, 0.00335f};
+
+#define APU_CLOCK_RATE 1789773.0 // NTSC CPU clock
+#define APU_FRAME_CYCLES 2048 // Audio frame length in CPU cycles
+
+static bool audio_enabled = true;
+static int output_rate = APU_DEFAULT_SAMPLE_RATE;
+static int output_quality = APU_QUALITY_MEDIUM;
+static const int quality_taps[3] = {8, 16, 32};
+
+// Dynamic rate control
+#define APU_LATENCY_MS 40       // Ring fill level to hold
+#define APU_DRC_MAX_DELTA 0.005 // Largest output rate adjustment (0.5%)
+static bool drc_enabled = false;
+static double drc_fill = 0.0; // Smoothed ring fill, in samples
+static double drc_trim = 0.0; // Integrated correction for steady drift
 
 // High-Pass Filters
 // The NES has two HPFs:
 // 1. First-order, approx 90Hz cutoff
 // 2. First-order, approx 440Hz cutoff
 // We will implement a single aggregate HPF to remove DC offset.
+#define APU_HPF_CUTOFF 28.1 // Hz; alpha = 0.996 at 44.1kHz
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+static float hpf_alpha = 0.996f;
 static float hpf_prev_in = 0.0f;
 static float hpf_prev_out = 0.0f;
-static float sample_accumulator = 0.0f; // Moved to file scope for reset
+
+// Note a channel's output level at `time`; a change becomes a band-limited
+// step in the output
+static void apu_emit(int ch, uint8_t out, uint32_t time) {
+  if (!audio_enabled)
+    return;
+  int delta = out - apu.level[ch];
+  if (delta != 0) {
+    apu.level[ch] = out;
+    blip_add_delta(time, delta * mix_weight[ch]);
+  }
+}
 
 // DMC Helper: Fill buffer if empty and bytes remaining
 static void dmc_fill_buffer(void) {
@@ -348,6 +437,7 @@ static void dmc_fill_buffer(void) {
     // MUST use bus_read() to avoid recursive system_step() calls!
     d->sample_buffer = bus_read(d->current_address);
     d->buffer_empty = false;
+    timeline_record(TIMELINE_DMC_FETCH, 0, d->sample_buffer);
 
     // printf("DMC: Filled buffer from $%04X (byte $%02X), %d bytes
     // remaining\n",
@@ -424,6 +514,7 @@ static void dmc_step(void) {
 
         d->output_level = new_level;
         d->shift_register >>= 1;
+        apu_emit(APU_CH_DMC, d->output_level, apu.frame_time);
       }
 
       d->bits_remaining--;
@@ -448,32 +539,255 @@ static void dmc_step(void) {
   }
 }
 
-static float mix_samples(void) {
-  uint8_t p1 = pulse_output(&apu.pulse1);
-  uint8_t p2 = pulse_output(&apu.pulse2);
-  uint8_t t = triangle_output(&apu.triangle);
-  uint8_t n = noise_output(&apu.noise);
-  uint8_t d = dmc_output(&apu.dmc);
+// ---------------------------
+// Lazy Channel Timers
+// ---------------------------
+
+// First cycle at or after `time` on which the APU-rate timers tick
+static uint32_t apu_next_tick(uint32_t time) {
+  bool ticks = apu.frame_apu_cycle ^ (time & 1);
+  return ticks ? time : time + 1;
+}
+
+// Run a timer that reloads from `period` for `ticks` clocks without
+// observing the expiries; returns how many times it expired
+static uint32_t timer_skip(uint16_t *timer, uint16_t period, uint32_t ticks) {
+  if (*timer >= ticks) {
+    *timer -= ticks;
+    return 0;
+  }
+  ticks -= *timer + 1;
+  uint32_t cycle = (uint32_t)period + 1;
+  *timer = period - ticks % cycle;
+  return 1 + ticks / cycle;
+}
+
+static void pulse_run(APU_Pulse *p, int ch, uint32_t end) {
+  uint32_t t = apu_next_tick(apu.synced);
+  if (t >= end)
+    return;
+  uint32_t ticks = (end - t + 1) / 2;
+
+  if (pulse_volume(p) == 0) {
+    // Silent: only the sequencer position has to come out right
+    uint32_t steps = timer_skip(&p->timer, p->timer_period, ticks);
+    p->duty_pos = (p->duty_pos + steps) & 7;
+    return;
+  }
+  while (p->timer < ticks) {
+    t += 2 * p->timer;
+    ticks -= p->timer + 1;
+    p->timer = p->timer_period;
+    p->duty_pos = (p->duty_pos + 1) & 7;
+    apu_emit(ch, pulse_output(p), t);
+    t += 2;
+  }
+  p->timer -= ticks;
+}
 
-  float pulse_out = 0.00752f * (p1 + p2);
-  float tnd_out = 0.00851f * t + 0.00494f * n + 0.00335f * d;
+// Triangle timer runs at CPU speed
+static void triangle_run(uint32_t end) {
+  APU_Triangle *tr = &apu.triangle;
+  uint32_t t = apu.synced;
+  if (t >= end)
+    return;
+  uint32_t ticks = end - t;
+
+  if (tr->linear_counter == 0 || tr->length_counter == 0) {
+    // The sequencer is halted; only the timer moves
+    timer_skip(&tr->timer, tr->timer_period, ticks);
+    return;
+  }
+  while (tr->timer < ticks) {
+    t += tr->timer;
+    ticks -= tr->timer + 1;
+    tr->timer = tr->timer_period;
+    tr->seq_index = (tr->seq_index + 1) & 31;
+    apu_emit(APU_CH_TRIANGLE, triangle_output(tr), t);
+    t++;
+  }
+  tr->timer -= ticks;
+}
 
-  float raw_output = pulse_out + tnd_out;
+static void noise_clock_lfsr(APU_Noise *n) {
+  uint16_t feedback;
+  if (n->mode) {
+    feedback = (n->lfsr & 1) ^ ((n->lfsr >> 6) & 1);
+  } else {
+    feedback = (n->lfsr & 1) ^ ((n->lfsr >> 1) & 1);
+  }
+  n->lfsr >>= 1;
+  n->lfsr |= (feedback << 14);
+}
 
-  // Simple High Pass Filter (RC filter implementation)
-  // y[i] = alpha * (y[i-1] + x[i] - x[i-1])
-  // alpha ~ 0.996 for reasonable DC removal
-  float alpha = 0.996f;
-  float filtered_out = alpha * (hpf_prev_out + raw_output - hpf_prev_in);
+static void noise_run(uint32_t end) {
+  APU_Noise *n = &apu.noise;
+  uint32_t t = apu_next_tick(apu.synced);
+  if (t >= end)
+    return;
+  uint32_t ticks = (end - t + 1) / 2;
+  bool audible = noise_volume(n) != 0;
+
+  while (n->timer < ticks) {
+    t += 2 * n->timer;
+    ticks -= n->timer + 1;
+    n->timer = n->timer_period; // Lookup table needed actually
+    noise_clock_lfsr(n);
+    if (audible)
+      apu_emit(APU_CH_NOISE, noise_output(n), t);
+    t += 2;
+  }
+  n->timer -= ticks;
+}
 
-  hpf_prev_in = raw_output;
-  hpf_prev_out = filtered_out;
+// Catch the lazy timers up to (not including) cycle `end` of the frame.
+// With audio off nothing can observe them, so they are left where they are.
+static void apu_sync(uint32_t end) {
+  if (audio_enabled) {
+    pulse_run(&apu.pulse1, APU_CH_PULSE1, end);
+    pulse_run(&apu.pulse2, APU_CH_PULSE2, end);
+    triangle_run(end);
+    noise_run(end);
+  }
+  apu.synced = end;
+}
 
-  return filtered_out;
+// After a register write or frame counter clock: emit any level changes
+static void apu_update_levels(uint32_t time) {
+  if (!audio_enabled)
+    return;
+  apu_emit(APU_CH_PULSE1, pulse_output(&apu.pulse1), time);
+  apu_emit(APU_CH_PULSE2, pulse_output(&apu.pulse2), time);
+  apu_emit(APU_CH_TRIANGLE, triangle_output(&apu.triangle), time);
+  apu_emit(APU_CH_NOISE, noise_output(&apu.noise), time);
+  apu_emit(APU_CH_DMC, dmc_output(&apu.dmc), time);
+}
+
+// Nudge the output rate toward the fill target: a draining ring gets a
+// slightly higher rate (more samples per emulated second), a filling one a
+// lower rate. Runs once per video frame when the frame pacer's wait ends,
+// the one point of the frame where the fill means the same thing to both:
+// during emulation the frame being produced sits on top of the level pacing
+// holds. The ring drains in callback-sized steps, so a wait ends on average
+// half a callback below the target. The fill is smoothed over ~8 frames and
+// a slow integral term takes over a steady clock mismatch.
+static void apu_rate_control(void) {
+  int target = apu_audio_target();
+  int fill = buffer_fill() +
+             atomic_load_explicit(&callback_samples, memory_order_relaxed) / 2;
+  drc_fill += (fill - drc_fill) / 8.0;
+  double error = (target - drc_fill) / target;
+  if (error > 1.0)
+    error = 1.0;
+  if (error < -1.0)
+    error = -1.0;
+
+  drc_trim += error * APU_DRC_MAX_DELTA / 256.0;
+  if (drc_trim > APU_DRC_MAX_DELTA)
+    drc_trim = APU_DRC_MAX_DELTA;
+  if (drc_trim < -APU_DRC_MAX_DELTA)
+    drc_trim = -APU_DRC_MAX_DELTA;
+
+  double adjust = APU_DRC_MAX_DELTA * error + drc_trim;
+  if (adjust > APU_DRC_MAX_DELTA)
+    adjust = APU_DRC_MAX_DELTA;
+  if (adjust < -APU_DRC_MAX_DELTA)
+    adjust = -APU_DRC_MAX_DELTA;
+  blip_set_rate(APU_CLOCK_RATE, output_rate * (1.0 + adjust));
+}
+
+// Finish the audio frame: synthesize its samples, filter them into the ring
+// and start the next frame at cycle 0
+static void apu_end_audio_frame(void) {
+  if (!audio_enabled) {
+    apu.frame_time = 0;
+    apu.synced = 0;
+    apu.frame_apu_cycle = apu.apu_cycle;
+    return;
+  }
+
+  apu_sync(apu.frame_time);
+  blip_end_frame(apu.frame_time);
+
+  float samples[128];
+  int count;
+  while ((count = blip_read_samples(samples, 128)) > 0) {
+    for (int i = 0; i < count; i++) {
+      // Simple High Pass Filter (RC filter implementation)
+      // y[i] = alpha * (y[i-1] + x[i] - x[i-1])
+      float in = samples[i];
+      float filtered_out = hpf_alpha * (hpf_prev_out + in - hpf_prev_in);
+
+      hpf_prev_in = in;
+      hpf_prev_out = filtered_out;
+      samples[i] = filtered_out;
+    }
+    buffer_write(samples, count);
+  }
+
+  apu.frame_time = 0;
+  apu.synced = 0;
+  apu.frame_apu_cycle = apu.apu_cycle;
+}
+
+// Rebuild the synthesizer for the current rate and quality. Pending output
+// is dropped; the channels' present levels are re-emitted from silence.
+static void apu_configure_output(void) {
+  blip_init(APU_CLOCK_RATE, output_rate, quality_taps[output_quality]);
+  hpf_alpha = (float)exp(-2.0 * M_PI * APU_HPF_CUTOFF / output_rate);
+  memset(apu.level, 0, sizeof(apu.level));
+  apu_update_levels(apu.frame_time);
+}
+
+void apu_set_sample_rate(int sample_rate) {
+  if (sample_rate < 8000)
+    sample_rate = 8000;
+  if (sample_rate > 192000)
+    sample_rate = 192000;
+  output_rate = sample_rate;
+  apu_configure_output();
+}
+
+void apu_set_quality(int quality) {
+  if (quality < APU_QUALITY_LOW || quality > APU_QUALITY_HIGH)
+    quality = APU_QUALITY_MEDIUM;
+  output_quality = quality;
+  apu_configure_output();
+}
+
+int apu_get_sample_rate(void) { return output_rate; }
+
+void apu_set_audio_enabled(bool enable) {
+  if (enable == audio_enabled)
+    return;
+  audio_enabled = enable;
+  apu.synced = apu.frame_time;
+  if (enable)
+    apu_configure_output(); // Restart from silence at the current levels
+}
+
+void apu_set_rate_control(bool enable) {
+  drc_enabled = enable;
+  drc_fill = apu_audio_target();
+  drc_trim = 0.0;
+  blip_set_rate(APU_CLOCK_RATE, output_rate);
+}
+
+int apu_audio_buffered(void) { return buffer_fill(); }
+
+void apu_audio_paced(void) {
+  if (drc_enabled)
+    apu_rate_control();
+}
+
+int apu_audio_target(void) {
+  int target = output_rate * APU_LATENCY_MS / 1000;
+  return target < AUDIO_BUFFER_SIZE / 2 ? target : AUDIO_BUFFER_SIZE / 2;
 }
 
 void apu_init(void) {
   printf("APU Init\n");
+  apu_configure_output();
   apu_reset();
 }
 
@@ -487,12 +801,11 @@ void apu_reset(void) {
   apu.dmc.buffer_empty = true;
 
   // Reset Audio State
-  buffer_read_pos = 0;
-  buffer_write_pos = 0;
+  // The ring is left alone: the audio callback may be reading it, and what
+  // is queued simply plays out
   hpf_prev_in = 0.0f;
   hpf_prev_out = 0.0f;
-  sample_accumulator = 0.0f;
-  memset(audio_buffer, 0, sizeof(audio_buffer));
+  blip_clear();
 }
 
 // Clock everything
@@ -514,8 +827,10 @@ void apu_step(void) {
 
       // If mode 1 (5-step), immediately clock length and envelope
       if (apu.frame_counter_mode == 1) {
+        apu_sync(apu.frame_time);
         clock_envelope();
         clock_length();
+        apu_update_levels(apu.frame_time);
       }
 
       // Reset frame counter (both modes)
@@ -525,61 +840,10 @@ void apu_step(void) {
   }
 
   // 2. Timers
-  // Pulse, Noise, DMC run at APU speed (every 2 CPU cycles)
-  if (apu.apu_cycle) {
-    // Pulse 1
-    if (apu.pulse1.timer > 0) {
-      apu.pulse1.timer--;
-    } else {
-      apu.pulse1.timer = apu.pulse1.timer_period;
-      apu.pulse1.duty_pos = (apu.pulse1.duty_pos + 1) & 7;
-    }
-
-    // Pulse 2
-    if (apu.pulse2.timer > 0) {
-      apu.pulse2.timer--;
-    } else {
-      apu.pulse2.timer = apu.pulse2.timer_period;
-      apu.pulse2.duty_pos = (apu.pulse2.duty_pos + 1) & 7;
-    }
-
-    // Noise
-    if (apu.noise.timer > 0) {
-      apu.noise.timer--;
-    } else {
-      apu.noise.timer = apu.noise.timer_period; // Lookup table needed actually
-      uint16_t feedback;
-      if (apu.noise.mode) {
-        feedback = (apu.noise.lfsr & 1) ^ ((apu.noise.lfsr >> 6) & 1);
-      } else {
-        feedback = (apu.noise.lfsr & 1) ^ ((apu.noise.lfsr >> 1) & 1);
-      }
-      apu.noise.lfsr >>= 1;
-      apu.noise.lfsr |= (feedback << 14);
-    }
-  }
-
+  // Pulse, Noise and Triangle are caught up lazily (apu_sync)
   // DMC runs at CPU speed (every cycle)
   dmc_step();
 
-  // Triangle runs at CPU speed (every cycle)
-  if (apu.triangle.timer > 0) {
-    apu.triangle.timer--;
-  } else {
-    apu.triangle.timer = apu.triangle.timer_period;
-    if (apu.triangle.linear_counter > 0 && apu.triangle.length_counter > 0) {
-      apu.triangle.seq_index = (apu.triangle.seq_index + 1) & 31;
-    }
-  }
-
-  // 3. Audio Sampling (Downsample to 44.1kHz)
-  // CPU(1.789773MHz) / 44100 ~= 40.5844...
-  sample_accumulator += 1.0f;
-  if (sample_accumulator >= 40.5844f) {
-    sample_accumulator -= 40.5844f;
-    buffer_write(mix_samples());
-  }
-
   // Original Frame Counter Logic (Cycle-Accurate)
   // Get the cycle count for the current step
   uint16_t step_cycles;
@@ -591,6 +855,7 @@ void apu_step(void) {
 
   if (apu.clock_count >= step_cycles) {
     apu.clock_count = 0;
+    apu_sync(apu.frame_time + 1); // Timers tick before the clocks
 
     // Mode 0: 4-Step Sequence
     if (apu.frame_counter_mode == 0) {
@@ -642,30 +907,45 @@ void apu_step(void) {
       if (apu.frame_step > 4)
         apu.frame_step = 0;
     }
+    apu_update_levels(apu.frame_time);
   }
 
   // Toggle APU cycle (Pulse/Noise/DMC run at half CPU speed)
   apu.apu_cycle = !apu.apu_cycle;
+
+  // 3. Audio output, one band-limited frame at a time
+  if (++apu.frame_time == APU_FRAME_CYCLES)
+    apu_end_audio_frame();
 }
 
 void apu_fill_buffer(void *userdata, uint8_t *stream, int len) {
   float *fstream = (float *)stream;
   int samples_needed = len / sizeof(float);
-
-  for (int i = 0; i < samples_needed; i++) {
-    if (buffer_read_pos != buffer_write_pos) {
-      fstream[i] = audio_buffer[buffer_read_pos];
-      buffer_read_pos = (buffer_read_pos + 1) % AUDIO_BUFFER_SIZE;
-    } else {
-      // Buffer underflow: Output silence (0.0f).
-      // Since we have a High-Pass Filter, the signal is centered at 0.0f,
-      // so silence is appropriate and shouldn't cause a huge pop
-      // unless the last sample was high amplitude (a real signal cut).
-      // For smoother handling, we could repeat the last sample, but 0.0f is
-      // safer for silence.
-      fstream[i] = 0.0f;
-    }
-  }
+  atomic_store_explicit(&callback_samples, samples_needed,
+                        memory_order_relaxed);
+
+  unsigned r =
+      atomic_load_explicit(&buffer_read_pos.value, memory_order_relaxed);
+  unsigned w =
+      atomic_load_explicit(&buffer_write_pos.value, memory_order_acquire);
+  int count = (int)(w - r);
+  if (count > samples_needed)
+    count = samples_needed;
+
+  unsigned start = r & AUDIO_BUFFER_MASK;
+  int first = AUDIO_BUFFER_SIZE - start;
+  if (first > count)
+    first = count;
+  memcpy(fstream, &audio_buffer[start], first * sizeof(float));
+  memcpy(fstream + first, audio_buffer, (count - first) * sizeof(float));
+  atomic_store_explicit(&buffer_read_pos.value, r + count,
+                        memory_order_release);
+
+  // Buffer underflow: Output silence (0.0f).
+  // Since we have a High-Pass Filter, the signal is centered at 0.0f,
+  // so silence is appropriate and shouldn't cause a huge pop
+  // unless the last sample was high amplitude (a real signal cut).
+  memset(fstream + count, 0, (samples_needed - count) * sizeof(float));
 }
 
 uint8_t apu_read_reg(uint16_t addr) {
@@ -702,6 +982,9 @@ uint8_t apu_read_reg(uint16_t addr) {
 }
 
 void apu_write_reg(uint16_t addr, uint8_t val) {
+  // Run the lazy timers up to the write before changing their state
+  apu_sync(apu.frame_time);
+
   switch (addr) {
   case 0x4000:
     apu_write_pulse(&apu.pulse1, 0, val);
@@ -826,4 +1109,6 @@ void apu_write_reg(uint16_t addr, uint8_t val) {
     }
     break;
   }
+
+  apu_update_levels(apu.frame_time);
 }
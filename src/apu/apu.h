@@ -1,12 +1,42 @@
 #ifndef APU_H
 #define APU_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 void apu_init(void);
 void apu_reset(void);
 void apu_step(void);
 
+// Output format, configured per machine. The APU synthesizes straight at
+// the output rate (8000-192000 Hz), so the audio device can run at its
+// native rate without another resampling pass. The quality preset picks the
+// width of the band-limiting kernel.
+#define APU_DEFAULT_SAMPLE_RATE 44100
+#define APU_QUALITY_LOW 0    // 8-tap kernel, cutoff at 0.80 of Nyquist
+#define APU_QUALITY_MEDIUM 1 // 16 taps, 0.90 (default)
+#define APU_QUALITY_HIGH 2   // 32 taps, 0.95
+void apu_set_sample_rate(int sample_rate);
+void apu_set_quality(int quality);
+int apu_get_sample_rate(void);
+
+// Audio-off mode, for runs where nothing plays the sound (e.g. headless).
+// Registers, length counters, the frame counter and its IRQ, and DMC DMA
+// (CPU stalls, sample fetches, IRQ) behave exactly as with audio on; the
+// channel timers, synthesis, filtering and the sample ring are skipped.
+void apu_set_audio_enabled(bool enable);
+
+// Dynamic rate control. While an audio device consumes the ring, the output
+// rate is nudged by up to 0.5% so the ring stays near apu_audio_target()
+// samples, absorbing drift between the emulated frame rate and the device
+// clock. The frontend paces emulation on the ring fill level and calls
+// apu_audio_paced() each time its wait for the ring to drain to the target
+// ends; rate control samples the fill there.
+void apu_set_rate_control(bool enable);
+int apu_audio_buffered(void); // Samples waiting in the ring
+int apu_audio_target(void);   // Fill level rate control aims for
+void apu_audio_paced(void);
+
 uint8_t apu_read_reg(uint16_t addr);
 void apu_write_reg(uint16_t addr, uint8_t val);
 
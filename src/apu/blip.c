@@ -0,0 +1,134 @@
+#include "blip.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define BLIP_PHASES (1 << BLIP_PHASE_BITS)
+#define BLIP_FRAC_BITS 32 // Output positions are 32.32 fixed point
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+// Impulse response per sub-sample phase, `taps` floats per row, each row
+// normalized to sum to 1 so an integrated delta settles at exactly its
+// amplitude
+static float kernel[BLIP_PHASES * BLIP_MAX_TAPS] __attribute__((aligned(16)));
+static int taps = 16;
+
+static float buffer[BLIP_BUFFER_SIZE + BLIP_MAX_TAPS];
+static uint64_t factor; // Output samples per CPU cycle, 32.32
+static uint64_t offset; // Output position of cycle 0 of the current frame
+static float integrator;
+
+static void blip_build_kernel(void) {
+  // Passband edge as a fraction of Nyquist: 0.80 / 0.90 / 0.95 for 8 / 16 /
+  // 32 taps, as far up as the transition band of each width allows
+  double cutoff = 1.0 - 1.6 / taps;
+
+  for (int p = 0; p < BLIP_PHASES; p++) {
+    float *row = &kernel[p * taps];
+    double frac = (double)p / BLIP_PHASES;
+    double sum = 0.0;
+    for (int i = 0; i < taps; i++) {
+      // Distance from the step, which sits between taps taps/2-1 and taps/2
+      double x = i - (taps / 2 - 1) - frac;
+      double s = cutoff * x;
+      double sinc = (s == 0.0) ? 1.0 : sin(M_PI * s) / (M_PI * s);
+      double w = 2.0 * M_PI * x / taps; // Blackman window
+      double window = 0.42 + 0.5 * cos(w) + 0.08 * cos(2.0 * w);
+      row[i] = (float)(sinc * window);
+      sum += sinc * window;
+    }
+    for (int i = 0; i < taps; i++)
+      row[i] = (float)(row[i] / sum);
+  }
+}
+
+void blip_set_rate(double clock_rate, double sample_rate) {
+  factor = (uint64_t)(sample_rate / clock_rate *
+                          (double)(1ULL << BLIP_FRAC_BITS) +
+                      0.5);
+}
+
+void blip_init(double clock_rate, double sample_rate, int kernel_taps) {
+  if (kernel_taps != 8 && kernel_taps != 32)
+    kernel_taps = 16;
+  taps = kernel_taps;
+  blip_set_rate(clock_rate, sample_rate);
+  blip_build_kernel();
+  blip_clear();
+}
+
+void blip_clear(void) {
+  memset(buffer, 0, sizeof(buffer));
+  offset = 0;
+  integrator = 0.0f;
+}
+
+// out[0..taps) += delta * k[0..taps); taps is a multiple of 8
+static inline void blip_accumulate(float *out, const float *k, float delta) {
+#if defined(__ARM_NEON)
+  float32x4_t d = vdupq_n_f32(delta);
+  for (int i = 0; i < taps; i += 8) {
+    float32x4_t a = vld1q_f32(out + i), b = vld1q_f32(out + i + 4);
+    a = vmlaq_f32(a, d, vld1q_f32(k + i));
+    b = vmlaq_f32(b, d, vld1q_f32(k + i + 4));
+    vst1q_f32(out + i, a);
+    vst1q_f32(out + i + 4, b);
+  }
+#elif defined(__SSE2__)
+  __m128 d = _mm_set1_ps(delta);
+  for (int i = 0; i < taps; i += 8) {
+    __m128 a = _mm_add_ps(_mm_loadu_ps(out + i),
+                          _mm_mul_ps(d, _mm_load_ps(k + i)));
+    __m128 b = _mm_add_ps(_mm_loadu_ps(out + i + 4),
+                          _mm_mul_ps(d, _mm_load_ps(k + i + 4)));
+    _mm_storeu_ps(out + i, a);
+    _mm_storeu_ps(out + i + 4, b);
+  }
+#else
+  for (int i = 0; i < taps; i++)
+    out[i] += delta * k[i];
+#endif
+}
+
+void blip_add_delta(uint32_t time, float delta) {
+  uint64_t pos = offset + time * factor;
+  uint32_t index = (uint32_t)(pos >> BLIP_FRAC_BITS);
+  uint32_t phase = (uint32_t)pos >> (BLIP_FRAC_BITS - BLIP_PHASE_BITS);
+  if (index >= BLIP_BUFFER_SIZE)
+    return; // Frame longer than the buffer; caller ends frames sooner
+
+  blip_accumulate(&buffer[index], &kernel[phase * taps], delta);
+}
+
+void blip_end_frame(uint32_t time) { offset += time * factor; }
+
+int blip_samples_avail(void) { return (int)(offset >> BLIP_FRAC_BITS); }
+
+int blip_read_samples(float *out, int count) {
+  int avail = blip_samples_avail();
+  if (count > avail)
+    count = avail;
+
+  float sum = integrator;
+  for (int i = 0; i < count; i++) {
+    sum += buffer[i];
+    out[i] = sum;
+  }
+  integrator = sum;
+
+  // Shift the unread samples and kernel tails down to the new origin; no
+  // delta lies past the end of the frame, so nothing beyond them is set
+  int keep = avail - count + taps;
+  memmove(buffer, buffer + count, keep * sizeof(float));
+  memset(buffer + keep, 0, count * sizeof(float));
+  offset -= (uint64_t)count << BLIP_FRAC_BITS;
+  return count;
+}
@@ -0,0 +1,38 @@
+#ifndef BLIP_H
+#define BLIP_H
+
+#include <stdint.h>
+
+// Band-limited step synthesis and resampling. Channels report amplitude
+// changes (deltas) at CPU-cycle times within the current audio frame; each
+// delta is added as a windowed-sinc impulse, taken from a polyphase table at
+// its fractional output-sample position, and reading integrates the
+// impulses back into steps. This converts the APU clock straight to any
+// output rate, band-limited at that rate, and nothing runs on cycles where
+// no channel changes.
+
+#define BLIP_MAX_TAPS 32      // Kernel width in output samples
+#define BLIP_PHASE_BITS 8     // 256 sub-sample kernel phases
+#define BLIP_BUFFER_SIZE 1024 // Output samples one frame may span
+
+// `taps` is 8, 16 or 32; wider kernels have a sharper cutoff closer to
+// Nyquist
+void blip_init(double clock_rate, double sample_rate, int taps);
+void blip_clear(void);
+
+// Change the output rate without disturbing buffered samples or the kernel
+void blip_set_rate(double clock_rate, double sample_rate);
+
+// Add an amplitude change at `time` CPU cycles into the current frame
+void blip_add_delta(uint32_t time, float delta);
+
+// Close the frame at `time` cycles; its complete samples become readable
+// and the next frame starts at time 0
+void blip_end_frame(uint32_t time);
+
+int blip_samples_avail(void);
+
+// Move up to `count` finished samples into `out`; returns the count
+int blip_read_samples(float *out, int count);
+
+#endif // BLIP_H
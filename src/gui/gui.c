@@ -1,6 +1,6 @@
 #include "gui.h"
 #include "apu.h"
-#include "ppu.h"
+#include "framebuffer.h"
 #include <SDL2/SDL.h>
 #include <stdio.h>
 
@@ -12,6 +12,12 @@ static SDL_Window *window = NULL;
 static SDL_Renderer *renderer = NULL;
 static SDL_Texture *texture = NULL;
 static bool running = false;
+static bool audio_active = false;
+
+// Row hashes of what the texture currently holds, so only rows that differ
+// from the last uploaded frame are sent to SDL
+static uint64_t uploaded_hash[WINDOW_HEIGHT];
+static uint64_t uploaded_frame;
 
 bool gui_init(void) {
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) < 0) {
@@ -46,13 +52,18 @@ bool gui_init(void) {
     return false;
   }
 
+  // Start black until the first frame is uploaded
+  static uint32_t black[WINDOW_WIDTH * WINDOW_HEIGHT];
+  SDL_UpdateTexture(texture, NULL, black, WINDOW_WIDTH * sizeof(uint32_t));
+  uploaded_frame = 0;
+
   // Audio Init
   SDL_AudioSpec want, have;
   SDL_memset(&want, 0, sizeof(want));
-  want.freq = 44100;
+  want.freq = apu_get_sample_rate();
   want.format = AUDIO_F32;
   want.channels = 1;
-  want.samples = 2048;
+  want.samples = 512; // ~12ms per callback, well inside the APU's fill target
   want.callback = (SDL_AudioCallback)apu_fill_buffer;
 
   if (SDL_OpenAudio(&want, &have) < 0) {
@@ -61,6 +72,13 @@ bool gui_init(void) {
     if (have.format != want.format) {
       printf("We didn't get Float32 audio format.\n");
     }
+    if (have.freq != want.freq) {
+      // Synthesize at the device's rate rather than have SDL convert
+      printf("Audio device runs at %d Hz\n", have.freq);
+      apu_set_sample_rate(have.freq);
+    }
+    apu_set_rate_control(true);
+    audio_active = true;
     SDL_PauseAudio(0); // Start playing
   }
 
@@ -68,7 +86,14 @@ bool gui_init(void) {
   return true;
 }
 
+bool gui_audio_active(void) { return audio_active; }
+
 void gui_cleanup(void) {
+  if (audio_active) {
+    SDL_CloseAudio();
+    apu_set_rate_control(false);
+    audio_active = false;
+  }
   if (texture)
     SDL_DestroyTexture(texture);
   if (renderer)
@@ -104,54 +129,38 @@ SDL_Scancode gui_poll_events(void) {
 
 bool gui_is_running(void) { return running; }
 
-// NES 2C02 Palette (RGB)
-static const uint32_t palette[64] = {
-    0x7C7C7C, 0x0000FC, 0x0000BC, 0x4428BC, 0x940084, 0xA80020, 0xA81000,
-    0x881400, 0x503000, 0x007800, 0x006800, 0x005800, 0x004058, 0x000000,
-    0x000000, 0x000000, 0xBCBCBC, 0x0078F8, 0x0058F8, 0x6844FC, 0xD800CC,
-    0xE40058, 0xF83800, 0xE45C10, 0xAC7C00, 0x00B800, 0x00A800, 0x00A844,
-    0x008888, 0x000000, 0x000000, 0x000000, 0xF8F8F8, 0x3CBCFC, 0x6888FC,
-    0x9878F8, 0xF878F8, 0xF85898, 0xF87858, 0xFCA044, 0xF8B800, 0xB8F818,
-    0x58D854, 0x58F898, 0x00E8D8, 0x787878, 0x000000, 0x000000, 0xFCFCFC,
-    0xA4E4FC, 0xB8B8F8, 0xD8B8F8, 0xF8B8F8, 0xF8A4C0, 0xF0D0B0, 0xFCE0A8,
-    0xF8D878, 0xD8F878, 0xB8F8B8, 0xB8F8D8, 0x00FCFC, 0xF8D8F8, 0x000000,
-    0x000000,
-};
-
-void gui_update_framebuffer(const uint8_t *nes_framebuffer) {
-  if (!nes_framebuffer)
-    return;
-
-  void *pixels;
-  int pitch;
-
-  if (SDL_LockTexture(texture, NULL, &pixels, &pitch) == 0) {
-    uint32_t *dst = (uint32_t *)pixels;
-    for (int i = 0; i < WINDOW_WIDTH * WINDOW_HEIGHT; i++) {
-      uint8_t index = nes_framebuffer[i] & 0x3F;
-      dst[i] = palette[index] | 0xFF000000;
+void gui_end_frame(void) {
+  // Newest complete frame; nothing to upload if it was already shown
+  const NES_Frame *frame = framebuffer_acquire();
+  if (frame && frame->number != uploaded_frame) {
+    // Upload each run of consecutive changed rows with one call
+    bool first_upload = uploaded_frame == 0;
+    int y = 0;
+    while (y < WINDOW_HEIGHT) {
+      if (!first_upload && frame->line_hash[y] == uploaded_hash[y]) {
+        y++;
+        continue;
+      }
+      int first = y;
+      while (y < WINDOW_HEIGHT &&
+             (first_upload || frame->line_hash[y] != uploaded_hash[y])) {
+        uploaded_hash[y] = frame->line_hash[y];
+        y++;
+      }
+
+      SDL_Rect rect = {0, first, WINDOW_WIDTH, y - first};
+      if (SDL_UpdateTexture(texture, &rect,
+                            &frame->pixels[first * WINDOW_WIDTH],
+                            WINDOW_WIDTH * sizeof(uint32_t)) != 0) {
+        printf("[GUI] Failed to update texture: %s\n", SDL_GetError());
+      }
     }
-    SDL_UnlockTexture(texture);
-
-  } else {
-    printf("[GUI] Failed to lock texture: %s\n", SDL_GetError());
+    uploaded_frame = frame->number;
   }
 
   SDL_RenderClear(renderer);
   SDL_RenderCopy(renderer, texture, NULL, NULL);
   // SDL_RenderPresent(renderer); // Moved to explicit call
-
-  static int frame_count = 0;
-  if (frame_count++ % 60 == 0) {
-    // Dump Palette
-    const uint8_t *pal = ppu_get_palette();
-    bool empty = true;
-    for (int i = 0; i < 32; i++) {
-      if (pal[i] != 0)
-        empty = false;
-    }
-    // printf("Palette State: %s\n", empty ? "EMPTY (All 0s)" : "HAS DATA");
-  }
 }
 
 void gui_render_present(void) {
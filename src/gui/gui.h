@@ -10,8 +10,11 @@ bool gui_init(void);
 void gui_cleanup(void);
 SDL_Scancode gui_poll_events(void);
 bool gui_is_running(void);
-void gui_update_framebuffer(const uint8_t *nes_framebuffer);
-void gui_update_framebuffer(const uint8_t *nes_framebuffer);
+// True once the audio device is open and pulling samples from the APU
+bool gui_audio_active(void);
+// Uploads the rows the PPU changed in the last frame and copies the texture
+// to the renderer
+void gui_end_frame(void);
 
 // Forces a render present (useful for overlay updates)
 void gui_render_present(void);
@@ -23,5 +26,9 @@ void gui_render_present(void);
 
 // Emulator Control
 void emulator_load_rom(const char *path);
+// Runs until the PPU completes a frame. With render_next == false the frame
+// after it is emulated exactly (NMI, IRQ, sprite 0 hit) but no pixels are
+// written; the first frame after a ROM load is always rendered.
+void emulator_run_frame(bool render_next);
 
 #endif
@@ -1,12 +1,16 @@
 #include "../system.h"
 #include "apu.h"
 #include "cpu.h"
+#include "framebuffer.h"
 #include "gui.h"
 #include "input.h"
 #include "input_config.h"
 #include "memory.h"
+#include "palette.h"
 #include "ppu.h"
+#include "render_thread.h"
 #include "rom.h"
+#include "timeline.h"
 #include <SDL2/SDL.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -42,7 +46,158 @@ void system_step(void) {
 
 static ROM *current_rom = NULL;
 
+// PPU output target. It persists between frames, so static frames can be
+// reused by the PPU; finished frames are handed to consumers through the
+// triple buffer in framebuffer.c.
+static uint32_t frame_pixels[FRAME_WIDTH * FRAME_HEIGHT];
+
+// Write an XRGB8888 image (rows packed) as a binary PPM
+static bool write_ppm(const char *path, const uint32_t *pixels, int width,
+                      int height) {
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    fprintf(stderr, "Failed to open image file: %s\n", path);
+    return false;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", width, height);
+  for (int y = 0; y < height; y++) {
+    const uint32_t *row = &pixels[y * width];
+    for (int x = 0; x < width; x++) {
+      uint8_t rgb[3] = {(row[x] >> 16) & 0xFF, (row[x] >> 8) & 0xFF,
+                        row[x] & 0xFF};
+      fwrite(rgb, 1, 3, f);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+// Write the last published frame as a binary PPM
+static bool dump_frame_ppm(const char *path) {
+  const NES_Frame *frame = framebuffer_acquire();
+  if (!frame) {
+    fprintf(stderr, "No frame to dump\n");
+    return false;
+  }
+  if (!write_ppm(path, frame->pixels, FRAME_WIDTH, FRAME_HEIGHT))
+    return false;
+  printf("Frame dumped to %s\n", path);
+  return true;
+}
+
+// Per-frame PPU statistics (--ppu-stats): a CSV row, or a JSON object when
+// the path ends in .json, for every emulated frame
+static FILE *stats_file = NULL;
+static bool stats_json = false;
+static uint32_t stats_rows = 0;
+
+static bool stats_open(const char *path) {
+  stats_file = fopen(path, "w");
+  if (!stats_file) {
+    fprintf(stderr, "Failed to open stats file: %s\n", path);
+    return false;
+  }
+  const char *ext = strrchr(path, '.');
+  stats_json = ext && strcmp(ext, ".json") == 0;
+  if (stats_json) {
+    fprintf(stats_file, "[\n");
+  } else {
+    fprintf(stats_file,
+            "frame,w2000,w2001,w2002,w2003,w2004,w2005,w2006,w2007,"
+            "midline_writes,vram_bytes,oam_dmas,sprites_evaluated,"
+            "overflow_lines,sprite0_line,sprite0_dot,lines_accurate,"
+            "lines_fast,lines_skipped\n");
+  }
+  ppu_set_stats(true);
+  return true;
+}
+
+static void stats_write(const PPU_FrameStats *st) {
+  const uint32_t *w = st->reg_writes;
+  if (stats_json) {
+    fprintf(stats_file,
+            "%s  {\"frame\": %u, \"reg_writes\": [%u, %u, %u, %u, %u, %u, "
+            "%u, %u], \"midline_writes\": %u, \"vram_bytes\": %u, "
+            "\"oam_dmas\": %u, \"sprites_evaluated\": %u, "
+            "\"overflow_lines\": %u, \"sprite0_line\": %d, "
+            "\"sprite0_dot\": %d, \"lines_accurate\": %u, "
+            "\"lines_fast\": %u, \"lines_skipped\": %u}",
+            stats_rows ? ",\n" : "", st->frame, w[0], w[1], w[2], w[3], w[4],
+            w[5], w[6], w[7], st->midline_writes, st->vram_bytes,
+            st->oam_dmas, st->sprites_evaluated, st->overflow_lines,
+            st->sprite0_line, st->sprite0_dot, st->lines_accurate,
+            st->lines_fast, st->lines_skipped);
+  } else {
+    fprintf(stats_file,
+            "%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%d,%d,%u,%u,%u\n",
+            st->frame, w[0], w[1], w[2], w[3], w[4], w[5], w[6], w[7],
+            st->midline_writes, st->vram_bytes, st->oam_dmas,
+            st->sprites_evaluated, st->overflow_lines, st->sprite0_line,
+            st->sprite0_dot, st->lines_accurate, st->lines_fast,
+            st->lines_skipped);
+  }
+  stats_rows++;
+}
+
+static void stats_close(void) {
+  if (!stats_file)
+    return;
+  if (stats_json)
+    fprintf(stats_file, "\n]\n");
+  fclose(stats_file);
+  stats_file = NULL;
+}
+
+// Raster event timeline (--timeline / --timeline-image): events are drained
+// after every frame into the binary trace, and the last frame's batch is
+// kept for the grid image written on exit
+static FILE *timeline_file = NULL;
+static Timeline_Event timeline_batch[TIMELINE_CAPACITY];
+static int timeline_batch_count = 0;
+
+static bool timeline_open(const char *path) {
+  if (path) {
+    timeline_file = fopen(path, "wb");
+    if (!timeline_file) {
+      fprintf(stderr, "Failed to open timeline file: %s\n", path);
+      return false;
+    }
+    fwrite(TIMELINE_MAGIC, 1, 8, timeline_file);
+  }
+  timeline_enable(true);
+  return true;
+}
+
+static void timeline_drain(void) {
+  timeline_batch_count = timeline_read(timeline_batch, TIMELINE_CAPACITY);
+  if (timeline_file)
+    fwrite(timeline_batch, sizeof(Timeline_Event), timeline_batch_count,
+           timeline_file);
+}
+
+static void timeline_close(const char *image_path) {
+  if (!timeline_enabled)
+    return;
+  if (image_path) {
+    static uint32_t image[TIMELINE_IMAGE_WIDTH * TIMELINE_IMAGE_HEIGHT];
+    timeline_render(timeline_batch, timeline_batch_count, image,
+                    TIMELINE_IMAGE_WIDTH * sizeof(uint32_t));
+    if (write_ppm(image_path, image, TIMELINE_IMAGE_WIDTH,
+                  TIMELINE_IMAGE_HEIGHT))
+      printf("Timeline image written to %s\n", image_path);
+  }
+  if (timeline_dropped())
+    fprintf(stderr, "Timeline: %u events dropped\n", timeline_dropped());
+  if (timeline_file)
+    fclose(timeline_file);
+  timeline_file = NULL;
+  timeline_enable(false);
+}
+
 void emulator_load_rom(const char *path) {
+  // The render thread may still be drawing from the old ROM's CHR
+  render_thread_flush();
+
   if (current_rom) {
     rom_free(current_rom);
     current_rom = NULL;
@@ -58,12 +213,77 @@ void emulator_load_rom(const char *path) {
   memory_init(current_rom);
   ppu_init(current_rom); // PPU needs ROM for mirroring/CHR
   ppu_reset();
+  apu_reset();
   cpu_init();
   cpu_reset();
 
   printf("ROM Loaded: %s\n", path);
 }
 
+void emulator_run_frame(bool render_next) {
+  // The PPU latches the skip flag at VBlank, so this frame's was set by the
+  // previous call and the request made here is for the next one
+  bool render = !ppu_get_state()->frame_skip;
+  ppu_set_frame_skip(!render_next);
+
+  while (!ppu_is_frame_complete()) {
+    cpu_step();
+
+    // Execution logging
+    static uint32_t total_cycles = 0;
+    total_cycles++;
+    if (total_cycles > 1000000) {
+      const CPU_State *s = cpu_get_state();
+      printf("Running... PC:%04X Cycles:%llu\n", s->pc, s->total_cycles);
+      fflush(stdout);
+      total_cycles = 0;
+    }
+  }
+  ppu_clear_frame_complete();
+
+  // Publish the finished frame; consumers never block emulation
+  if (render && ppu_get_output()->pixels)
+    framebuffer_submit(frame_pixels, FRAME_WIDTH * sizeof(uint32_t),
+                       ppu_get_line_hashes());
+}
+
+#define NES_FRAME_RATE 60.0988 // NTSC
+
+// Frame pacing. With an audio device, audio is the master clock: wait until
+// the device has drained the ring to the rate-control target, which keeps
+// emulation in step with the sound card without drift. Without one, hold
+// the NTSC frame rate against the wall clock. The audio wait gives up after
+// two frame periods in case the device stops consuming (unplugged, paused,
+// backend stall), and that frame falls back to the wall-clock deadline so
+// the main loop keeps polling events.
+static void pace_frame(void) {
+  static uint64_t deadline = 0;
+  uint64_t freq = SDL_GetPerformanceFrequency();
+  uint64_t period = (uint64_t)(freq / NES_FRAME_RATE);
+
+  if (gui_audio_active()) {
+    uint64_t limit = SDL_GetPerformanceCounter() + 2 * period;
+    int excess;
+    while ((excess = apu_audio_buffered() - apu_audio_target()) > 0 &&
+           gui_audio_active() && SDL_GetPerformanceCounter() < limit) {
+      uint32_t ms = (uint32_t)((int64_t)excess * 1000 / apu_get_sample_rate());
+      SDL_Delay(ms ? ms : 1);
+    }
+    if (excess <= 0) {
+      apu_audio_paced();
+      deadline = SDL_GetPerformanceCounter(); // Keep a fallback in step
+      return;
+    }
+  }
+
+  uint64_t now = SDL_GetPerformanceCounter();
+  if (deadline == 0 || now > deadline + 4 * period)
+    deadline = now; // Start, or resync after a stall instead of catching up
+  deadline += period;
+  if (now < deadline)
+    SDL_Delay((uint32_t)((deadline - now) * 1000 / freq));
+}
+
 int main(int argc, char *argv[]) {
   init_logging();
   printf("NEStupid - NES Emulator\n");
@@ -71,11 +291,59 @@ int main(int argc, char *argv[]) {
   // Initialize Input (Independent of ROM)
   input_init();
   input_config_init();
+  palette_init();
+  apu_init();
 
   bool headless = false;
+  const char *dump_path = NULL;
+  int frame_skip = 0;
+  bool render_thread = false;
+  const char *stats_path = NULL;
+  const char *timeline_path = NULL;
+  const char *timeline_image = NULL;
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "--headless") == 0) {
       headless = true;
+    } else if (strcmp(argv[i], "--dump-frame") == 0 && i + 1 < argc) {
+      dump_path = argv[++i];
+    } else if (strcmp(argv[i], "--frame-skip") == 0 && i + 1 < argc) {
+      frame_skip = atoi(argv[++i]);
+      if (frame_skip < 0)
+        frame_skip = 0;
+    } else if (strcmp(argv[i], "--render-thread") == 0) {
+      render_thread = true;
+    } else if (strcmp(argv[i], "--ppu-stats") == 0 && i + 1 < argc) {
+      stats_path = argv[++i];
+    } else if (strcmp(argv[i], "--timeline") == 0 && i + 1 < argc) {
+      timeline_path = argv[++i];
+    } else if (strcmp(argv[i], "--timeline-image") == 0 && i + 1 < argc) {
+      timeline_image = argv[++i];
+    } else if (strcmp(argv[i], "--sample-rate") == 0 && i + 1 < argc) {
+      apu_set_sample_rate(atoi(argv[++i]));
+    } else if (strcmp(argv[i], "--audio-quality") == 0 && i + 1 < argc) {
+      const char *q = argv[++i];
+      apu_set_quality(strcmp(q, "low") == 0    ? APU_QUALITY_LOW
+                      : strcmp(q, "high") == 0 ? APU_QUALITY_HIGH
+                                               : APU_QUALITY_MEDIUM);
+    }
+  }
+
+  if (stats_path)
+    stats_open(stats_path);
+  if (timeline_path || timeline_image)
+    timeline_open(timeline_path);
+
+  // Without a window or a dump there is nothing to look at, so no pixels are
+  // written
+  framebuffer_init();
+  if (!headless || dump_path) {
+    if (render_thread && render_thread_start()) {
+      // Pixels are drawn and published by the render thread instead
+      ppu_set_deferred(true);
+    } else {
+      ppu_set_output(frame_pixels, FRAME_WIDTH * sizeof(uint32_t),
+                     PALETTE_FORMAT_XRGB8888);
+      ppu_set_frame_reuse(true);
     }
   }
 
@@ -88,6 +356,7 @@ int main(int argc, char *argv[]) {
     }
   } else {
     printf("Running in Headless Mode\n");
+    apu_set_audio_enabled(false); // Nothing consumes the samples
   }
 
   // Load ROM from CLI if provided
@@ -137,37 +406,26 @@ int main(int argc, char *argv[]) {
 
     // --- Emulation Step ---
     if (current_rom) {
-      while (!ppu_is_frame_complete()) {
-        cpu_step();
-
-        // Execution logging
-        static uint32_t total_cycles = 0;
-        total_cycles++;
-        if (total_cycles > 1000000) {
-          const CPU_State *s = cpu_get_state();
-          printf("Running... PC:%04X Cycles:%llu\n", s->pc, s->total_cycles);
-          fflush(stdout);
-          total_cycles = 0;
-        }
-      }
-      ppu_clear_frame_complete();
+      // Only every (frame_skip + 1)th frame produces pixels
+      static uint32_t frame_index = 0;
+      bool render_next = (++frame_index % (frame_skip + 1)) == 0;
+
+      emulator_run_frame(render_next);
+      if (stats_file)
+        stats_write(ppu_get_frame_stats());
+      if (timeline_enabled)
+        timeline_drain();
     }
 
     if (!headless) {
       // --- Video Update ---
-      gui_update_framebuffer(ppu_get_framebuffer());
+      gui_end_frame();
 
       // Final Present
       gui_render_present();
 
-      // --- Timing (Simple Cap at 60 FPS) ---
-      static uint64_t last_time = 0;
-      uint64_t current_time = SDL_GetTicks64();
-      uint64_t elapsed = current_time - last_time;
-      if (elapsed < 16) {
-        SDL_Delay(16 - elapsed);
-      }
-      last_time = SDL_GetTicks64();
+      // --- Timing ---
+      pace_frame();
     } else {
       // Headless progress logging
       static uint32_t total_cycles = 0;
@@ -185,6 +443,15 @@ int main(int argc, char *argv[]) {
     }
   }
 
+  // Let the render thread finish the frames it was handed
+  render_thread_flush();
+  if (dump_path && current_rom)
+    dump_frame_ppm(dump_path);
+  ppu_set_deferred(false);
+  render_thread_stop();
+  stats_close();
+  timeline_close(timeline_image);
+
   gui_cleanup();
   if (current_rom)
     rom_free(current_rom);
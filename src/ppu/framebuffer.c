@@ -0,0 +1,55 @@
+#include "framebuffer.h"
+#include <stdatomic.h>
+#include <string.h>
+
+// Slot indices: the producer owns `back`, the consumer owns `front`, and
+// `middle` holds the third slot plus a flag saying it has not been consumed
+// yet. Each side hands its slot over with a single atomic exchange.
+#define SLOT_MASK 0x03
+#define SLOT_FRESH 0x04
+
+static NES_Frame slots[3];
+static _Atomic uint8_t middle;
+static uint8_t back;  // Producer only
+static uint8_t front; // Consumer only
+static uint64_t frame_number;
+static bool published;
+
+void framebuffer_init(void) {
+  memset(slots, 0, sizeof(slots));
+  back = 0;
+  atomic_store(&middle, 1);
+  front = 2;
+  frame_number = 0;
+  published = false;
+}
+
+void framebuffer_submit(const uint32_t *pixels, int pitch,
+                        const uint64_t *line_hash) {
+  NES_Frame *slot = &slots[back];
+
+  for (int y = 0; y < FRAME_HEIGHT; y++) {
+    if (slot->line_hash[y] == line_hash[y] && slot->number != 0)
+      continue;
+    memcpy(&slot->pixels[y * FRAME_WIDTH],
+           (const uint8_t *)pixels + (size_t)y * pitch,
+           FRAME_WIDTH * sizeof(uint32_t));
+    slot->line_hash[y] = line_hash[y];
+  }
+  slot->number = ++frame_number;
+
+  // Release: the slot's contents are visible before the consumer can take it
+  uint8_t prev = atomic_exchange_explicit(&middle, back | SLOT_FRESH,
+                                          memory_order_acq_rel);
+  back = prev & SLOT_MASK;
+}
+
+const NES_Frame *framebuffer_acquire(void) {
+  if (atomic_load_explicit(&middle, memory_order_relaxed) & SLOT_FRESH) {
+    uint8_t prev =
+        atomic_exchange_explicit(&middle, front, memory_order_acq_rel);
+    front = prev & SLOT_MASK;
+    published = true;
+  }
+  return published ? &slots[front] : NULL;
+}
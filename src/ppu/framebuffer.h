@@ -0,0 +1,33 @@
+#ifndef FRAMEBUFFER_H
+#define FRAMEBUFFER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Triple-buffered frame handoff from the emulation thread (producer) to one
+// consumer (GUI upload, video encoder, observation export), which may run on
+// another thread. Neither side ever waits: the producer always has a free
+// slot to fill and the consumer always gets the newest complete frame.
+
+#define FRAME_WIDTH 256
+#define FRAME_HEIGHT 240
+
+typedef struct {
+  uint32_t pixels[FRAME_WIDTH * FRAME_HEIGHT]; // XRGB8888
+  uint64_t line_hash[FRAME_HEIGHT];            // Hash of each row (see PPU)
+  uint64_t number;                             // Increments per submit
+} NES_Frame;
+
+void framebuffer_init(void);
+
+// Producer: copy a finished XRGB8888 frame into the back slot and publish
+// it. Only rows whose hash differs from what the slot already holds are
+// copied.
+void framebuffer_submit(const uint32_t *pixels, int pitch,
+                        const uint64_t *line_hash);
+
+// Consumer: newest published frame, or NULL before the first submit. The
+// frame stays untouched until the consumer's next acquire.
+const NES_Frame *framebuffer_acquire(void);
+
+#endif // FRAMEBUFFER_H
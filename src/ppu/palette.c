@@ -0,0 +1,174 @@
+#include "palette.h"
+#include <stddef.h>
+#include <string.h>
+
+// The 64-entry table lookups (vqtbl4q_u8) exist on AArch64 only; 32-bit
+// NEON targets take the scalar path
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define PALETTE_ARM64_NEON 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PALETTE_X86_AVX2 1
+#endif
+
+// NES 2C02 Palette (RGB)
+static const uint32_t base_palette[64] = {
+    0x7C7C7C, 0x0000FC, 0x0000BC, 0x4428BC, 0x940084, 0xA80020, 0xA81000,
+    0x881400, 0x503000, 0x007800, 0x006800, 0x005800, 0x004058, 0x000000,
+    0x000000, 0x000000, 0xBCBCBC, 0x0078F8, 0x0058F8, 0x6844FC, 0xD800CC,
+    0xE40058, 0xF83800, 0xE45C10, 0xAC7C00, 0x00B800, 0x00A800, 0x00A844,
+    0x008888, 0x000000, 0x000000, 0x000000, 0xF8F8F8, 0x3CBCFC, 0x6888FC,
+    0x9878F8, 0xF878F8, 0xF85898, 0xF87858, 0xFCA044, 0xF8B800, 0xB8F818,
+    0x58D854, 0x58F898, 0x00E8D8, 0x787878, 0x000000, 0x000000, 0xFCFCFC,
+    0xA4E4FC, 0xB8B8F8, 0xD8B8F8, 0xF8B8F8, 0xF8A4C0, 0xF0D0B0, 0xFCE0A8,
+    0xF8D878, 0xD8F878, 0xB8F8B8, 0xB8F8D8, 0x00FCFC, 0xF8D8F8, 0x000000,
+    0x000000,
+};
+
+// Each set emphasis bit darkens the two other channels (NTSC 2C02 bit order:
+// bit 0 = red, bit 1 = green, bit 2 = blue)
+#define EMPHASIS_ATTENUATION 0.816f
+
+static uint32_t palette_lut[PALETTE_LUT_SIZE];
+static uint16_t palette_lut_rgb565[PALETTE_LUT_SIZE];
+static uint8_t palette_lut_gray[PALETTE_LUT_SIZE];
+
+#if defined(PALETTE_ARM64_NEON)
+// Byte planes of the LUT (B, G, R per emphasis) for 64-entry table lookups
+static uint8_t palette_planes[8][3][64];
+#endif
+
+void palette_init(void) {
+  for (int emph = 0; emph < 8; emph++) {
+    float scale[3] = {1.0f, 1.0f, 1.0f}; // R, G, B
+    for (int bit = 0; bit < 3; bit++) {
+      if (emph & (1 << bit)) {
+        for (int c = 0; c < 3; c++) {
+          if (c != bit)
+            scale[c] *= EMPHASIS_ATTENUATION;
+        }
+      }
+    }
+
+    for (int i = 0; i < 64; i++) {
+      uint32_t rgb = base_palette[i];
+      uint32_t r = (uint32_t)(((rgb >> 16) & 0xFF) * scale[0]);
+      uint32_t g = (uint32_t)(((rgb >> 8) & 0xFF) * scale[1]);
+      uint32_t b = (uint32_t)((rgb & 0xFF) * scale[2]);
+      palette_lut[(emph << 6) | i] = 0xFF000000 | (r << 16) | (g << 8) | b;
+      palette_lut_rgb565[(emph << 6) | i] =
+          (uint16_t)(((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3));
+      palette_lut_gray[(emph << 6) | i] =
+          (uint8_t)((r * 77 + g * 150 + b * 29) >> 8); // BT.601 luma
+
+#if defined(PALETTE_ARM64_NEON)
+      palette_planes[emph][0][i] = (uint8_t)b;
+      palette_planes[emph][1][i] = (uint8_t)g;
+      palette_planes[emph][2][i] = (uint8_t)r;
+#endif
+    }
+  }
+}
+
+static void palette_convert_scalar(const uint8_t *indices, uint32_t *dst,
+                                   int count, const uint32_t *lut) {
+  for (int i = 0; i < count; i++) {
+    dst[i] = lut[indices[i] & 0x3F];
+  }
+}
+
+#if defined(PALETTE_X86_AVX2)
+// 8 pixels per iteration via a 32-bit gather. Compiled for AVX2 regardless of
+// the global flags and only called after a runtime CPU check.
+__attribute__((target("avx2"))) static int
+palette_convert_avx2(const uint8_t *indices, uint32_t *dst, int count,
+                     const uint32_t *lut) {
+  const __m256i mask = _mm256_set1_epi32(0x3F);
+  int i = 0;
+  for (; i + 8 <= count; i += 8) {
+    __m128i raw = _mm_loadl_epi64((const __m128i *)(indices + i));
+    __m256i idx = _mm256_and_si256(_mm256_cvtepu8_epi32(raw), mask);
+    __m256i px = _mm256_i32gather_epi32((const int *)lut, idx, 4);
+    _mm256_storeu_si256((__m256i *)(dst + i), px);
+  }
+  return i;
+}
+#endif
+
+void palette_convert_line(const uint8_t *indices, uint32_t *dst, int count,
+                          uint8_t emphasis) {
+  emphasis &= 0x07;
+  const uint32_t *lut = &palette_lut[emphasis << 6];
+  int done = 0;
+
+#if defined(PALETTE_ARM64_NEON)
+  // 16 pixels per iteration: a 64-byte table lookup per color plane, then an
+  // interleaving store writes B, G, R, A bytes (ARGB8888 in memory).
+  const uint8x16_t mask = vdupq_n_u8(0x3F);
+  const uint8x16_t alpha = vdupq_n_u8(0xFF);
+  uint8x16x4_t planes[3];
+  for (int c = 0; c < 3; c++) {
+    planes[c] = vld1q_u8_x4(palette_planes[emphasis][c]);
+  }
+  for (; done + 16 <= count; done += 16) {
+    uint8x16_t idx = vandq_u8(vld1q_u8(indices + done), mask);
+    uint8x16x4_t px;
+    px.val[0] = vqtbl4q_u8(planes[0], idx);
+    px.val[1] = vqtbl4q_u8(planes[1], idx);
+    px.val[2] = vqtbl4q_u8(planes[2], idx);
+    px.val[3] = alpha;
+    vst4q_u8((uint8_t *)(dst + done), px);
+  }
+#elif defined(PALETTE_X86_AVX2)
+  static int has_avx2 = -1;
+  if (has_avx2 < 0)
+    has_avx2 = __builtin_cpu_supports("avx2") ? 1 : 0;
+  if (has_avx2)
+    done = palette_convert_avx2(indices, dst, count, lut);
+#endif
+
+  palette_convert_scalar(indices + done, dst + done, count - done, lut);
+}
+
+int palette_format_bytes(uint8_t format) {
+  switch (format) {
+  case PALETTE_FORMAT_INDEX8:
+  case PALETTE_FORMAT_GRAY8:
+    return 1;
+  case PALETTE_FORMAT_RGB565:
+    return 2;
+  case PALETTE_FORMAT_XRGB8888:
+    return 4;
+  default:
+    return 0;
+  }
+}
+
+void palette_convert_line_to(const uint8_t *indices, void *dst, int count,
+                             uint8_t emphasis, uint8_t format) {
+  const int base = (emphasis & 0x07) << 6;
+
+  switch (format) {
+  case PALETTE_FORMAT_INDEX8:
+    memcpy(dst, indices, count);
+    break;
+  case PALETTE_FORMAT_RGB565: {
+    uint16_t *out = dst;
+    for (int i = 0; i < count; i++)
+      out[i] = palette_lut_rgb565[base | (indices[i] & 0x3F)];
+    break;
+  }
+  case PALETTE_FORMAT_XRGB8888:
+    palette_convert_line(indices, dst, count, emphasis);
+    break;
+  case PALETTE_FORMAT_GRAY8: {
+    uint8_t *out = dst;
+    for (int i = 0; i < count; i++)
+      out[i] = palette_lut_gray[base | (indices[i] & 0x3F)];
+    break;
+  }
+  default:
+    break;
+  }
+}
@@ -0,0 +1,31 @@
+#ifndef PALETTE_H
+#define PALETTE_H
+
+#include <stdint.h>
+
+// NES 2C02 color lookup: 64 colors x 8 emphasis combinations (PPUMASK bits
+// 5-7), precomputed as ARGB8888. Entry = (emphasis << 6) | color_index.
+#define PALETTE_LUT_SIZE 512
+
+// Output pixel formats
+#define PALETTE_FORMAT_INDEX8 0   // Palette index as-is (1 byte, no emphasis)
+#define PALETTE_FORMAT_RGB565 1   // 16-bit RGB (2 bytes)
+#define PALETTE_FORMAT_XRGB8888 2 // 32-bit ARGB8888 with alpha = 0xFF (4 bytes)
+#define PALETTE_FORMAT_GRAY8 3    // Luma (1 byte)
+
+// Build the lookup table (call once at startup)
+void palette_init(void);
+
+// Convert one scanline of palette indices to ARGB8888.
+// `emphasis` is PPUMASK >> 5 for that line.
+void palette_convert_line(const uint8_t *indices, uint32_t *dst, int count,
+                          uint8_t emphasis);
+
+// Bytes per pixel for a PALETTE_FORMAT_* value (0 if unknown)
+int palette_format_bytes(uint8_t format);
+
+// Convert one scanline into any PALETTE_FORMAT_* layout
+void palette_convert_line_to(const uint8_t *indices, void *dst, int count,
+                             uint8_t emphasis, uint8_t format);
+
+#endif // PALETTE_H
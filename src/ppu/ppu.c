@@ -1,34 +1,92 @@
 #include "ppu.h"
 #include "cpu.h"
 #include "mapper.h"
+#include "render_thread.h"
+#include "timeline.h"
 #include <stdio.h>
 #include <string.h>
 
-static PPU_State ppu;
+// The emulation thread's PPU. A render thread replaying a deferred job points
+// `ppu` at the job's copy instead, so the same code draws both.
+static PPU_State ppu_main;
+static _Thread_local PPU_State *ppu_cur = &ppu_main;
+#define ppu (*ppu_cur)
+
+static void ppu_sprite_lines_rebuild(void);
+static void ppu_content_rehash(void);
+static void ppu_defer_begin(void);
+static void ppu_chr_map(void);
+static void ppu_idle_flush(int end);
+static void ppu_pixel_flush(int end);
+static void ppu_defer_drop(void);
+static void ppu_phase_build(void);
+static void ppu_select_mode(void);
+static void ppu_latch_frame_settings(void);
 
 void ppu_init(ROM *rom) {
+  // Output settings belong to the embedder and survive a ROM load
+  PPU_OutputTarget output = ppu.output;
+  bool reuse_enabled = ppu.reuse_enabled;
+  bool deferred = ppu.deferred;
+  bool stats_enabled = ppu.stats_enabled;
+  int16_t roi[4];
+  memcpy(roi, ppu.roi_next, sizeof(roi));
+  uint32_t chr_signature = ppu.chr_signature; // Set by mapper_init
+  uint32_t chr_bank[8];
+  memcpy(chr_bank, ppu.chr_bank, sizeof(chr_bank));
+  ppu_defer_drop();
   memset(&ppu, 0, sizeof(PPU_State));
+  ppu.output = output;
+  ppu.reuse_enabled = reuse_enabled;
+  ppu.deferred = deferred;
+  ppu.stats_enabled = stats_enabled;
+  if (roi[2] > roi[0] && roi[3] > roi[1])
+    ppu_set_render_region(roi[0], roi[1], roi[2], roi[3]);
+  else
+    ppu_set_render_region(0, 0, 256, 240);
+  ppu_latch_frame_settings();
+  ppu.stats.sprite0_line = ppu.stats.sprite0_dot = -1;
+  ppu.chr_signature = chr_signature;
+  memcpy(ppu.chr_bank, chr_bank, sizeof(chr_bank));
+  ppu.journal_len[0] = ppu.journal_len[1] = -1;
+  ppu.idle_x = -1;
+  ppu.pixel_x = -1;
   ppu.rom = rom;
+  ppu.chr_data = rom ? rom->chr_data : NULL;
+  ppu_chr_map();
+  ppu_set_mirroring(mapper_get_mirroring());
+  ppu_sprite_lines_rebuild();
+  ppu_phase_build();
+  ppu_select_mode();
   printf("PPU Initialized\n");
 }
 
 void ppu_reset(void) {
+  ppu_defer_drop();
   ppu.ctrl = 0;
   ppu.mask = 0;
+  ppu_select_mode();
   ppu.status = 0;
   ppu.oam_addr = 0;
   ppu.scanline = 0;
   ppu.dot = 0;
+  ppu.idle_x = -1;
+  ppu.pixel_x = -1;
   ppu.v = 0;
   ppu.t = 0;
   ppu.w = 0;
   ppu.fine_x = 0;
   ppu.frame_complete = false;
   memset(ppu.oam, 0, sizeof(ppu.oam));
+  ppu_sprite_lines_rebuild();
   memset(ppu.secondary_oam, 0xFF, sizeof(ppu.secondary_oam));
   ppu.sprite_count = 0;
   ppu.sprite_zero_hit_possible = false;
   memset(ppu.palette, 0, sizeof(ppu.palette));
+  ppu_content_rehash();
+  ppu.output_valid = false;
+  ppu.reuse_active = false;
+  ppu.journal_len[0] = ppu.journal_len[1] = -1;
   printf("PPU Reset\n");
 }
 
@@ -43,54 +101,433 @@ static void ppu_increment_vaddr(void) {
   }
 }
 
-// Read/Write access to VRAM
+// --- Sprite Occupancy ---
+// Instead of scanning all 64 OAM entries at dot 257 of every line, each
+// scanline keeps a 64-bit mask of the sprites covering it. Masks are patched
+// whenever a sprite's Y byte changes and rebuilt when the sprite size changes.
 
-// Helper for Nametable Mirroring
-static uint16_t ppu_mirror_nametable_addr(uint16_t addr) {
-  addr &= 0x0FFF;
-  uint8_t mirroring = mapper_get_mirroring();
+static void ppu_sprite_lines_set(int sprite, uint8_t y, bool present) {
+  uint64_t bit = 1ULL << sprite;
+  int end = y + ppu.sprite_line_height;
+  if (end > 240)
+    end = 240;
 
-  if (mirroring == MIRRORING_VERTICAL) {
-    if (addr & 0x0400)
-      return 1024 + (addr & 0x03FF);
-    else
-      return (addr & 0x03FF);
-  } else if (mirroring == MIRRORING_HORIZONTAL) {
-    if (addr & 0x0800)
-      return 1024 + (addr & 0x03FF);
+  for (int line = y; line < end; line++) {
+    if (present)
+      ppu.sprite_line_mask[line] |= bit;
     else
-      return (addr & 0x03FF);
-  } else if (mirroring == MIRRORING_ONE_SCREEN_LO) {
-    return addr & 0x03FF;
-  } else if (mirroring == MIRRORING_ONE_SCREEN_HI) {
-    return 1024 + (addr & 0x03FF);
+      ppu.sprite_line_mask[line] &= ~bit;
+  }
+}
+
+static void ppu_sprite_lines_rebuild(void) {
+  ppu.sprite_line_height = (ppu.ctrl & PPU_CTRL_SPR_SIZE) ? 16 : 8;
+  memset(ppu.sprite_line_mask, 0, sizeof(ppu.sprite_line_mask));
+  for (int i = 0; i < 64; i++) {
+    ppu_sprite_lines_set(i, ppu.oam[i * 4], true);
+  }
+}
+
+// --- VRAM Content Hash ---
+// Used by static-screen reuse. The hash is the XOR of one value per non-zero
+// byte of nametable (cells 0x0000-0x0FFF), palette (0x1000-0x101F) and OAM
+// (0x1100-0x11FF) memory, so a write updates it in O(1) and restoring a byte
+// restores the hash.
+
+static inline uint64_t ppu_mix64(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+static inline uint64_t ppu_cell_hash(uint32_t cell, uint8_t val) {
+  return val ? ppu_mix64(((uint64_t)cell << 8) | val) : 0;
+}
+
+static inline void ppu_cell_write(uint32_t cell, uint8_t *dst, uint8_t val) {
+  if (ppu.reuse_enabled)
+    ppu.vram_hash ^= ppu_cell_hash(cell, *dst) ^ ppu_cell_hash(cell, val);
+  *dst = val;
+}
+
+static void ppu_content_rehash(void) {
+  ppu.vram_hash = 0;
+  for (int i = 0; i < 4096; i++)
+    ppu.vram_hash ^= ppu_cell_hash(i, ppu.nametables[i]);
+  for (int i = 0; i < 32; i++)
+    ppu.vram_hash ^= ppu_cell_hash(0x1000 + i, ppu.palette[i]);
+  for (int i = 0; i < 256; i++)
+    ppu.vram_hash ^= ppu_cell_hash(0x1100 + i, ppu.oam[i]);
+}
+
+// All OAM stores go through here so the occupancy masks stay in sync
+static void ppu_oam_write(uint8_t addr, uint8_t val) {
+  if (ppu.oam[addr] == val)
+    return;
+  if ((addr & 0x03) == 0) {
+    ppu_sprite_lines_set(addr >> 2, ppu.oam[addr], false);
+    ppu_sprite_lines_set(addr >> 2, val, true);
+  }
+  ppu_cell_write(0x1100 + addr, &ppu.oam[addr], val);
+}
+
+// --- Static-Screen Reuse ---
+
+static inline uint32_t ppu_frame_pos(void) {
+  return ppu.scanline * 341 + ppu.dot;
+}
+
+// Every rendering input a CPU access can change
+static uint64_t ppu_input_hash(void) {
+  uint64_t regs = (uint64_t)ppu.ctrl | ((uint64_t)ppu.mask << 8) |
+                  ((uint64_t)ppu.v << 16) | ((uint64_t)ppu.t << 32) |
+                  ((uint64_t)ppu.fine_x << 48) | ((uint64_t)ppu.w << 51) |
+                  ((uint64_t)ppu.mirroring << 52);
+  uint64_t chr = ((uint64_t)ppu.chr_generation << 32) | ppu.chr_signature;
+  return ppu_mix64(regs ^ ppu_mix64(chr) ^ ppu.vram_hash);
+}
+
+// Inputs at the start of a frame, including the background tiles prefetched
+// for line 0 at the end of the pre-render line
+static uint64_t ppu_start_fingerprint(void) {
+  uint64_t shifters = (uint64_t)ppu.bg_shifter_pattern_lo |
+                      ((uint64_t)ppu.bg_shifter_pattern_hi << 16) |
+                      ((uint64_t)ppu.bg_shifter_attrib_lo << 32) |
+                      ((uint64_t)ppu.bg_shifter_attrib_hi << 48);
+  uint64_t latches = (uint64_t)ppu.bg_next_tile_id |
+                     ((uint64_t)ppu.bg_next_tile_attrib << 8) |
+                     ((uint64_t)ppu.bg_next_tile_lsb << 16) |
+                     ((uint64_t)ppu.bg_next_tile_msb << 24);
+  return ppu_mix64(ppu_input_hash() ^ ppu_mix64(shifters) ^
+                   ppu_mix64(~latches));
+}
+
+// The frame stops reusing pixels; whatever this line already passed still
+// matches the previous frame and stays in the target
+static void ppu_reuse_stop(void) {
+  ppu.reuse_active = false;
+  if (ppu.scanline < 240 && ppu.dot >= 1 && ppu.dot <= 256)
+    ppu.line_start = ppu.dot - 1;
+}
+
+// Snapshot taken before an access; 0 when reuse is off
+static inline uint64_t ppu_journal_begin(void) {
+  return ppu.reuse_enabled ? ppu_input_hash() : 0;
+}
+
+// Record the access if it changed an input, and check it against the
+// previous frame's journal. Only visible lines are journaled: accesses in
+// VBlank and on the pre-render line can only affect the next frame, whose
+// start fingerprint already covers them.
+static void ppu_journal_note(uint64_t before) {
+  if (!ppu.reuse_enabled || ppu.scanline >= 240)
+    return;
+  uint64_t after = ppu_input_hash();
+  if (after == before)
+    return;
+
+  uint32_t pos = ppu_frame_pos();
+  int cur = ppu.journal_cur;
+  int n = ppu.journal_len[cur];
+  if (n >= 0 && n < PPU_JOURNAL_SIZE) {
+    ppu.journal_pos[cur][n] = pos;
+    ppu.journal_hash[cur][n] = after;
+    ppu.journal_len[cur] = n + 1;
+  } else {
+    ppu.journal_len[cur] = -1;
+  }
+
+  if (ppu.reuse_active) {
+    int prev = cur ^ 1;
+    int m = ppu.journal_match;
+    if (m < ppu.journal_len[prev] && ppu.journal_pos[prev][m] == pos &&
+        ppu.journal_hash[prev][m] == after) {
+      ppu.journal_match++;
+    } else {
+      ppu_reuse_stop();
+    }
+  }
+}
+
+// An access the previous frame made by now has not happened in this one
+static inline void ppu_reuse_check(void) {
+  int prev = ppu.journal_cur ^ 1;
+  if (ppu.journal_match < ppu.journal_len[prev] &&
+      ppu.journal_pos[prev][ppu.journal_match] <= ppu_frame_pos()) {
+    ppu_reuse_stop();
+  }
+}
+
+// Timeline events come from the emulation thread only, not from a replay
+static inline void ppu_timeline(uint8_t kind, uint8_t reg, uint8_t value) {
+  if (timeline_enabled && !ppu.replay)
+    timeline_push(kind, reg, value);
+}
+
+// Apply the settings requested for the next frame. Runs as line 240 begins:
+// this frame's last line is out, and the pre-render line has yet to fetch
+// line 0's sprites, which already depend on them.
+static void ppu_latch_frame_settings(void) {
+  ppu.frame_skip = ppu.frame_skip_next;
+  if (ppu.roi_next[0] != ppu.roi_x0 || ppu.roi_next[1] != ppu.roi_y0 ||
+      ppu.roi_next[2] != ppu.roi_x1 || ppu.roi_next[3] != ppu.roi_y1) {
+    ppu.roi_x0 = ppu.roi_next[0];
+    ppu.roi_y0 = ppu.roi_next[1];
+    ppu.roi_x1 = ppu.roi_next[2];
+    ppu.roi_y1 = ppu.roi_next[3];
+    // Rows and columns that just entered the region hold nothing a reused
+    // frame could keep
+    ppu.output_changed = true;
+  }
+}
+
+// Called when the PPU wraps to line 0
+static void ppu_frame_begin(void) {
+  ppu_timeline(TIMELINE_FRAME, 0, 0);
+  if (ppu.stats_enabled) {
+    ppu.stats_last = ppu.stats;
+    uint32_t frame = ppu.stats.frame + 1;
+    memset(&ppu.stats, 0, sizeof(ppu.stats));
+    ppu.stats.frame = frame;
+    ppu.stats.sprite0_line = ppu.stats.sprite0_dot = -1;
+  }
+  if (ppu.deferred) {
+    ppu_defer_begin();
+  }
+
+  memcpy(ppu.line_dirty, ppu.line_dirty_next, sizeof(ppu.line_dirty));
+  memset(ppu.line_dirty_next, 0, sizeof(ppu.line_dirty_next));
+
+  ppu.frame_reused = ppu.reuse_matched;
+  ppu.reuse_matched = false;
+  ppu.output_valid =
+      ppu.output.pixels && !ppu.frame_skip && !ppu.output_changed;
+  if (ppu.output_changed) // Report every row of a frame drawn afresh
+    memset(ppu.line_dirty_next, 0xFF, sizeof(ppu.line_dirty_next));
+  ppu.output_changed = false;
+  ppu.line_start = 0;
+  if (!ppu.reuse_enabled)
+    return;
+
+  int prev = ppu.journal_cur;
+  ppu.journal_cur ^= 1;
+  ppu.journal_len[ppu.journal_cur] = 0;
+  ppu.journal_match = 0;
+
+  ppu.frame_start_fp[1] = ppu.frame_start_fp[0];
+  ppu.frame_start_fp[0] = ppu_start_fingerprint();
+  ppu.reuse_active = ppu.output_valid && ppu.journal_len[prev] >= 0 &&
+                     ppu.frame_start_fp[0] == ppu.frame_start_fp[1];
+}
+
+void ppu_set_frame_reuse(bool enable) {
+  ppu.reuse_enabled = enable;
+  ppu_content_rehash();
+  ppu.reuse_active = false;
+  ppu.journal_len[0] = ppu.journal_len[1] = -1;
+}
+
+bool ppu_frame_was_reused(void) { return ppu.frame_reused; }
+
+const uint64_t *ppu_get_dirty_lines(void) { return ppu.line_dirty; }
+
+const uint64_t *ppu_get_line_hashes(void) { return ppu.line_hash; }
+
+// --- Instrumentation ---
+
+void ppu_set_stats(bool enable) {
+  if (enable && !ppu.stats_enabled) {
+    memset(&ppu.stats, 0, sizeof(ppu.stats));
+    memset(&ppu.stats_last, 0, sizeof(ppu.stats_last));
+    ppu.stats.sprite0_line = ppu.stats.sprite0_dot = -1;
+    ppu.stats_last.sprite0_line = ppu.stats_last.sprite0_dot = -1;
+  }
+  ppu.stats_enabled = enable;
+}
+
+const PPU_FrameStats *ppu_get_frame_stats(void) { return &ppu.stats_last; }
+
+// Sprite 0 hit is about to be set
+static inline void ppu_stats_sprite0(int x) {
+  if (ppu.stats_enabled && !(ppu.status & PPU_STATUS_SPR0_HIT)) {
+    ppu.stats.sprite0_line = ppu.scanline;
+    ppu.stats.sprite0_dot = x + 1;
+  }
+}
+
+// --- Deferred Rendering ---
+
+// Start recording a frame at line 0, dot 0. The snapshot is everything the
+// replay needs except CHR-RAM, which is copied alongside.
+static void ppu_defer_begin(void) {
+  PPU_FrameJob *job = render_thread_begin_job();
+  memcpy(&job->start, &ppu, sizeof(PPU_State));
+  if (ppu.rom && ppu.rom->is_chr_ram && ppu.rom->chr_data) {
+    size_t size = ppu.rom->chr_size;
+    if (size > PPU_DEFER_CHR_RAM)
+      size = PPU_DEFER_CHR_RAM;
+    memcpy(job->chr_ram, ppu.rom->chr_data, size);
+  }
+  job->event_count = 0;
+  job->dma_count = 0;
+  job->chr_bank_count = 0;
+  job->overflow = false;
+  ppu.defer_job = job;
+}
+
+// Line 239 is recorded: hand the job over (skipped frames draw nothing)
+static void ppu_defer_end(void) {
+  render_thread_end_job(ppu.defer_job, !ppu.frame_skip);
+  ppu.defer_job = NULL;
+}
+
+// A job in progress no longer describes what the PPU does (ROM load, reset)
+static void ppu_defer_drop(void) {
+  if (ppu.defer_job) {
+    render_thread_end_job(ppu.defer_job, false);
+    ppu.defer_job = NULL;
+  }
+}
+
+static void ppu_defer_record(uint8_t kind, uint16_t addr, uint8_t value) {
+  PPU_FrameJob *job = ppu.defer_job;
+  if (job->event_count == PPU_DEFER_EVENTS) {
+    job->overflow = true;
+    return;
+  }
+  PPU_Event *ev = &job->events[job->event_count++];
+  ev->pos = ppu_frame_pos();
+  ev->addr = addr;
+  ev->kind = kind;
+  ev->value = value;
+}
+
+// Point the pattern pages at chr_data. Without CHR data every page reads as
+// zeros and ignores writes.
+static void ppu_chr_map(void) {
+  static uint8_t chr_none[1024];
+  bool ram = ppu.chr_data && ppu.rom && ppu.rom->is_chr_ram;
+  for (int i = 0; i < 8; i++) {
+    ppu.chr_page[i] = ppu.chr_data ? ppu.chr_data + ppu.chr_bank[i] : chr_none;
+  }
+  ppu.chr_writable = ram ? 0xFF : 0x00;
+}
+
+void ppu_set_chr_banks(const uint32_t pages[8]) {
+  if (memcmp(pages, ppu.chr_bank, sizeof(ppu.chr_bank)) == 0)
+    return;
+
+  uint64_t before = ppu_journal_begin();
+  uint32_t sig = 2166136261u;
+  for (int i = 0; i < 8; i++) {
+    ppu.chr_bank[i] = pages[i];
+    sig = (sig ^ (pages[i] >> 10)) * 16777619u;
+  }
+  ppu.chr_signature = sig;
+  ppu_chr_map();
+  ppu_journal_note(before);
+
+  PPU_FrameJob *job = ppu.defer_job;
+  if (job) {
+    if (job->chr_bank_count < PPU_DEFER_CHR_BANKS) {
+      memcpy(job->chr_banks[job->chr_bank_count], pages, sizeof(ppu.chr_bank));
+      ppu_defer_record(PPU_EVENT_CHR_BANKS, job->chr_bank_count++, 0);
+    } else {
+      job->overflow = true;
+    }
+  }
+}
+
+// Read/Write access to VRAM
+
+// Nametable Mirroring
+// Each 1KB window of $2000-$2FFF points at a page of VRAM, so resolving a
+// nametable address is one mask and one load. Pages per mirroring mode:
+static const uint8_t nt_page_layout[5][4] = {
+    [MIRRORING_HORIZONTAL] = {0, 0, 1, 1},
+    [MIRRORING_VERTICAL] = {0, 1, 0, 1},
+    [MIRRORING_FOUR_SCREEN] = {0, 1, 2, 3},
+    [MIRRORING_ONE_SCREEN_LO] = {0, 0, 0, 0},
+    [MIRRORING_ONE_SCREEN_HI] = {1, 1, 1, 1},
+};
+
+void ppu_set_mirroring(uint8_t mirroring) {
+  if (mirroring > MIRRORING_ONE_SCREEN_HI)
+    mirroring = MIRRORING_ONE_SCREEN_LO; // Default fail-safe
+
+  uint64_t before = ppu_journal_begin();
+  for (int i = 0; i < 4; i++) {
+    ppu.nt_page[i] = &ppu.nametables[nt_page_layout[mirroring][i] * 1024];
+    ppu.at_page[i] = ppu.attr_shadow[nt_page_layout[mirroring][i]];
+  }
+  if (ppu.defer_job && mirroring != ppu.mirroring)
+    ppu_defer_record(PPU_EVENT_MIRRORING, 0, mirroring);
+  ppu.mirroring = mirroring;
+  ppu_journal_note(before);
+}
+
+static inline uint8_t *ppu_nametable_ptr(uint16_t addr) {
+  return &ppu.nt_page[(addr >> 10) & 0x03][addr & 0x03FF];
+}
+
+// Palette RAM entry for $3F00-$3FFF: $3F10/$3F14/$3F18/$3F1C mirror the
+// backdrop entries $3F00/$3F04/$3F08/$3F0C
+static inline uint8_t ppu_palette_index(uint16_t addr) {
+  addr &= 0x001F;
+  if ((addr & 0x13) == 0x10)
+    addr &= 0x0F;
+  return addr;
+}
+
+// Address presented on the PPU bus, for mapper IRQ counters. A replay
+// leaves the mapper alone: the emulation thread already ticked it.
+static inline void ppu_bus_tick(uint16_t addr) {
+  if (!ppu.replay)
+    mapper_ppu_tick(addr);
+}
+
+// Pattern table access ($0000-$1FFF) through the page table
+static inline uint8_t ppu_chr_read(uint16_t addr) {
+  return ppu.chr_page[addr >> 10][addr & 0x03FF];
+}
+
+static inline void ppu_chr_write(uint16_t addr, uint8_t val) {
+  if (ppu.chr_writable & (1 << (addr >> 10)))
+    ppu.chr_page[addr >> 10][addr & 0x03FF] = val;
+}
+
+// An attribute byte ($x3C0-$x3FF of a nametable) sets the palette of a 4x4
+// tile block, 2 bits per 2x2 quadrant
+static void ppu_attr_shadow_write(uint32_t cell, uint8_t val) {
+  uint8_t *shadow = ppu.attr_shadow[cell >> 10];
+  int block = (cell & 0x03FF) - 0x03C0;
+  int tx0 = (block & 0x07) * 4, ty0 = (block >> 3) * 4;
+
+  for (int ty = ty0; ty < ty0 + 4; ty++) {
+    for (int tx = tx0; tx < tx0 + 4; tx++) {
+      int shift = ((ty & 0x02) << 1) | (tx & 0x02);
+      shadow[ty * 32 + tx] = (val >> shift) & 0x03;
+    }
   }
-  return addr & 0x03FF; // Default fail-safe
 }
 
 static uint8_t ppu_vram_read(uint16_t addr) {
   addr &= 0x3FFF;
 
-  mapper_ppu_tick(addr); // Snooping
+  ppu_bus_tick(addr); // Snooping
 
   if (addr < 0x2000) {
-    return mapper_ppu_read(addr);
+    return ppu_chr_read(addr);
   }
 
   if (addr < 0x3F00) {
-    return ppu.nametables[ppu_mirror_nametable_addr(addr)];
+    return *ppu_nametable_ptr(addr);
   }
 
   if (addr >= 0x3F00) {
-    addr &= 0x001F;
-    if (addr == 0x10)
-      addr = 0x00;
-    if (addr == 0x14)
-      addr = 0x04;
-    if (addr == 0x18)
-      addr = 0x08;
-    if (addr == 0x1C)
-      addr = 0x0C;
+    addr = ppu_palette_index(addr);
     return ppu.palette[addr];
   }
   return 0;
@@ -99,48 +536,62 @@ static uint8_t ppu_vram_read(uint16_t addr) {
 static void ppu_vram_write(uint16_t addr, uint8_t val) {
   addr &= 0x3FFF;
 
-  mapper_ppu_tick(addr); // Snooping
+  ppu_bus_tick(addr); // Snooping
 
   if (addr < 0x2000) {
-    mapper_ppu_write(addr, val);
+    // CHR-RAM cells move with banking, so they only get a generation count
+    if (ppu.reuse_enabled && ppu_chr_read(addr) != val)
+      ppu.chr_generation++;
+    ppu_chr_write(addr, val);
   } else if (addr < 0x3F00) {
-    ppu.nametables[ppu_mirror_nametable_addr(addr)] = val;
+    uint8_t *cell = ppu_nametable_ptr(addr);
+    ppu_cell_write(cell - ppu.nametables, cell, val);
+    if ((addr & 0x03C0) == 0x03C0)
+      ppu_attr_shadow_write(cell - ppu.nametables, val);
   } else if (addr >= 0x3F00) {
-    addr &= 0x001F;
-    if (addr == 0x10)
-      addr = 0x00;
-    if (addr == 0x14)
-      addr = 0x04;
-    if (addr == 0x18)
-      addr = 0x08;
-    if (addr == 0x1C)
-      addr = 0x0C;
-    ppu.palette[addr] = val;
+    addr = ppu_palette_index(addr);
+    ppu_cell_write(0x1000 + addr, &ppu.palette[addr], val);
   }
 }
 
 uint8_t ppu_read_reg(uint16_t addr) {
+  if (ppu.idle_x >= 0)
+    ppu_idle_flush(ppu.dot - 1);
+  if (ppu.pixel_x >= 0)
+    ppu_pixel_flush(ppu.dot - 1);
+
   switch (addr & 0x0007) {
   case 2: // PPUSTATUS
   {
+    if (ppu.defer_job)
+      ppu_defer_record(PPU_EVENT_READ, addr, 0);
+    uint64_t before = ppu_journal_begin();
     uint8_t status = ppu.status;
+    ppu_timeline(TIMELINE_STATUS_READ, 2, status);
     ppu.status &= ~PPU_STATUS_VBLANK;
     ppu.w = 0;
+    ppu_journal_note(before);
     return status;
   }
   case 4: // OAMDATA
     return ppu.oam[ppu.oam_addr];
   case 7: // PPUDATA
   {
+    if (ppu.defer_job)
+      ppu_defer_record(PPU_EVENT_READ, addr, 0);
+    uint64_t before = ppu_journal_begin();
     uint8_t val = ppu.data_buffer;
     uint16_t addr = ppu.v & 0x3FFF;
+    if (ppu.stats_enabled)
+      ppu.stats.vram_bytes++;
     ppu.data_buffer = ppu_vram_read(addr);
     if (addr >= 0x3F00) {
       val = ppu.data_buffer;
       // When reading palettes, the buffer is loaded with the mirrored VRAM data
-      ppu.data_buffer = ppu.nametables[ppu_mirror_nametable_addr(addr)];
+      ppu.data_buffer = *ppu_nametable_ptr(addr);
     }
     ppu_increment_vaddr();
+    ppu_journal_note(before);
     return val;
   }
   }
@@ -148,23 +599,45 @@ uint8_t ppu_read_reg(uint16_t addr) {
 }
 
 void ppu_write_reg(uint16_t addr, uint8_t val) {
+  // The pixels drawn so far used the state before this write
+  if (ppu.idle_x >= 0)
+    ppu_idle_flush(ppu.dot - 1);
+  if (ppu.pixel_x >= 0)
+    ppu_pixel_flush(ppu.dot - 1);
+  if (ppu.defer_job)
+    ppu_defer_record(PPU_EVENT_WRITE, addr, val);
+  ppu_timeline(TIMELINE_REG_WRITE, addr & 0x0007, val);
+  if (ppu.stats_enabled) {
+    ppu.stats.reg_writes[addr & 0x0007]++;
+    if (ppu.scanline < 240 && ppu.dot >= 1 && ppu.dot <= 256)
+      ppu.stats.midline_writes++;
+    if ((addr & 0x0007) == 7)
+      ppu.stats.vram_bytes++;
+  }
+  uint64_t before = ppu_journal_begin();
+
   switch (addr & 0x0007) {
   case 0: // PPUCTRL
+  {
     // printf("PPUCTRL Write: %02X\n", val);
+    bool size_changed = (ppu.ctrl ^ val) & PPU_CTRL_SPR_SIZE;
     ppu.ctrl = val;
     ppu.t = (ppu.t & 0xF3FF) | ((val & 0x03) << 10);
-    break;
+    if (size_changed)
+      ppu_sprite_lines_rebuild();
+  } break;
   case 1: // PPUMASK
     // printf("PPUMASK Write: %02X (BG:%d SPR:%d)\n", val,
     //        (val & PPU_MASK_SHOW_BG) ? 1 : 0, (val & PPU_MASK_SHOW_SPR) ? 1 :
     //        0);
     ppu.mask = val;
+    ppu_select_mode();
     break;
   case 3: // OAMADDR
     ppu.oam_addr = val;
     break;
   case 4: // OAMDATA
-    ppu.oam[ppu.oam_addr++] = val;
+    ppu_oam_write(ppu.oam_addr++, val);
     break;
   case 5: // PPUSCROLL
     if (ppu.w == 0) {
@@ -195,18 +668,69 @@ void ppu_write_reg(uint16_t addr, uint8_t val) {
     ppu_increment_vaddr();
     break;
   }
+
+  ppu_journal_note(before);
+}
+
+static void ppu_oam_dma(const uint8_t *page_data) {
+  uint64_t before = ppu_journal_begin();
+  for (int i = 0; i < 256; i++) {
+    ppu_oam_write(ppu.oam_addr++, page_data[i]);
+  }
+  ppu_journal_note(before);
 }
 
 void ppu_dma(uint8_t *page_data) {
   printf("DMA Start OAM Addr: %02X\n", ppu.oam_addr);
-  for (int i = 0; i < 256; i++) {
-    ppu.oam[ppu.oam_addr++] = page_data[i];
+  if (ppu.stats_enabled)
+    ppu.stats.oam_dmas++;
+  ppu_timeline(TIMELINE_OAM_DMA, 4, ppu.oam_addr);
+  PPU_FrameJob *job = ppu.defer_job;
+  if (job) {
+    if (job->dma_count < PPU_DEFER_DMA) {
+      memcpy(job->dma[job->dma_count], page_data, 256);
+      ppu_defer_record(PPU_EVENT_DMA, job->dma_count++, 0);
+    } else {
+      job->overflow = true;
+    }
   }
+  ppu_oam_dma(page_data);
   // CPU stalls for 513 or 514 cycles usually. Not implemented yet.
 }
 
 // --- Rendering Helpers ---
 
+// Bit-reversal table for horizontally flipped sprite patterns
+#define R2(n) n, n + 2 * 64, n + 1 * 64, n + 3 * 64
+#define R4(n) R2(n), R2(n + 2 * 16), R2(n + 1 * 16), R2(n + 3 * 16)
+#define R6(n) R4(n), R4(n + 2 * 4), R4(n + 1 * 4), R4(n + 3 * 4)
+static const uint8_t bit_reverse[256] = {R6(0), R6(2), R6(1), R6(3)};
+#undef R2
+#undef R4
+#undef R6
+
+// Sprite line buffer entries: bits 0-1 pixel, bits 2-3 palette,
+// plus priority and sprite 0 flags. 0 means transparent.
+#define SPRITE_PIXEL_BEHIND 0x20 // Same bit as OAM attribute priority
+#define SPRITE_PIXEL_ZERO 0x40
+
+// Paint one fetched sprite row into the line buffer. Slots are painted in
+// OAM order and never overwrite an opaque pixel, so the first (highest
+// priority) sprite wins, as on hardware.
+static void ppu_paint_sprite(int slot, uint8_t x, uint8_t attr, uint8_t lo,
+                             uint8_t hi) {
+  uint8_t tag = ((attr & 0x03) << 2) | (attr & SPRITE_PIXEL_BEHIND);
+  if (slot == 0 && ppu.sprite_zero_hit_possible)
+    tag |= SPRITE_PIXEL_ZERO;
+
+  for (int b = 0; b < 8 && x + b < 256; b++) {
+    uint8_t pix = (((hi >> (7 - b)) & 1) << 1) | ((lo >> (7 - b)) & 1);
+    uint8_t *dst = &ppu.sprite_line_buffer[x + b];
+    if (pix != 0 && *dst == 0)
+      *dst = tag | pix;
+  }
+}
+
 static void ppu_increment_scroll_x(void) {
   if ((ppu.v & 0x001F) == 31) { // Coarse X = 31
     ppu.v &= ~0x001F;           // Coarse X = 0
@@ -216,24 +740,27 @@ static void ppu_increment_scroll_x(void) {
   }
 }
 
-static void ppu_increment_scroll_y(void) {
-  if ((ppu.v & 0x7000) != 0x7000) { // If Fine Y < 7
-    ppu.v += 0x1000;                // Increment Fine Y
+static uint16_t ppu_scroll_y_next(uint16_t v) {
+  if ((v & 0x7000) != 0x7000) { // If Fine Y < 7
+    v += 0x1000;                // Increment Fine Y
   } else {
-    ppu.v &= ~0x7000;              // Fine Y = 0
-    int y = (ppu.v & 0x03E0) >> 5; // Coarse Y
+    v &= ~0x7000;              // Fine Y = 0
+    int y = (v & 0x03E0) >> 5; // Coarse Y
     if (y == 29) {
       y = 0;
-      ppu.v ^= 0x0800; // Switch Vertical Nametable
+      v ^= 0x0800; // Switch Vertical Nametable
     } else if (y == 31) {
       y = 0; // In case of weird Y=31
     } else {
       y += 1;
     }
-    ppu.v = (ppu.v & ~0x03E0) | (y << 5);
+    v = (v & ~0x03E0) | (y << 5);
   }
+  return v;
 }
 
+static void ppu_increment_scroll_y(void) { ppu.v = ppu_scroll_y_next(ppu.v); }
+
 static void ppu_transfer_address_x(void) {
   // v: .....F.. ...EDCBA = t: .....F.. ...EDCBA
   ppu.v = (ppu.v & 0xFBE0) | (ppu.t & 0x041F);
@@ -266,382 +793,614 @@ static void ppu_update_shifters(void) {
   }
 }
 
-void ppu_step(void) {
-  bool rendering_enabled = (ppu.mask & (PPU_MASK_SHOW_BG | PPU_MASK_SHOW_SPR));
+// Grayscale keeps only the luma column of the palette ($x0)
+static inline uint8_t ppu_color_mask(void) {
+  return (ppu.mask & PPU_MASK_GRAYSCALE) ? 0x30 : 0x3F;
+}
 
-  // Visible Scanlines (0-239)
-  if (ppu.scanline <= 239) {
+// Rendering off: pixels [idle_x, end) of the line show the backdrop, or the
+// palette entry v points at when v is in $3F00-$3FFF. The run's first
+// palette fetch reaches the mapper as the run opens, so the A12 rise it may
+// cause clocks the IRQ counter on time. The remaining fetches keep A12 high
+// and cannot clock it; they and the pixels follow in one go when the line
+// ends or a register access may change the color.
+static void ppu_idle_flush(int end) {
+  int count = end - ppu.idle_x;
+  uint16_t addr = ((ppu.v & 0x3F00) == 0x3F00) ? ppu.v : 0x3F00;
+  uint8_t color = ppu.palette[ppu_palette_index(addr)] & ppu_color_mask();
+
+  memset(&ppu.line_pixels[ppu.idle_x], color, count);
+  if (!ppu.replay)
+    mapper_ppu_tick_repeat(0x3F00, count - 1);
+  ppu.idle_x = -1;
+}
 
-    // --- Sprite Evaluation (Cycles 1-256) ---
-    // Standard Behavior: Only happens if rendering is enabled
-    // Simplified Logic:
-    // 1. Clear Secondary OAM (Cycles 1-64)
-    if (ppu.dot == 1) {
-      // In hardware this takes 64 cycles. Instant here.
-      memset(ppu.secondary_oam, 0xFF, sizeof(ppu.secondary_oam));
-      ppu.sprite_count = 0;
-      ppu.sprite_zero_hit_possible = false;
+// Pixel dot of a skipped frame: no color is resolved, but sprite 0 hit is
+// tested against the real BG opacity and the palette lookup is still
+// presented to the mapper so A12 snooping matches a rendered frame.
+static inline void ppu_skip_pixel(int x) {
+  const uint8_t both = PPU_MASK_SHOW_BG | PPU_MASK_SHOW_SPR;
+  const uint8_t both_left = PPU_MASK_SHOW_BG_LEFT | PPU_MASK_SHOW_SPR_LEFT;
+
+  if ((ppu.sprite_line_buffer[x] & SPRITE_PIXEL_ZERO) && x != 255 &&
+      (ppu.mask & both) == both &&
+      (x >= 8 || (ppu.mask & both_left) == both_left)) {
+    uint16_t bit_mux = 0x8000 >> ppu.fine_x;
+    if ((ppu.bg_shifter_pattern_lo | ppu.bg_shifter_pattern_hi) & bit_mux) {
+      ppu_stats_sprite0(x);
+      ppu.status |= PPU_STATUS_SPR0_HIT;
     }
+  }
 
-    // 2. Sprite Evaluation (Cycles 65-256)
-    if (rendering_enabled && ppu.dot == 257) {
-      // Scan OAM
-      int count = 0;
-      uint8_t sprite_size = (ppu.ctrl & PPU_CTRL_SPR_SIZE) ? 16 : 8;
-
-      for (int i = 0; i < 64; i++) {
-        uint8_t y = ppu.oam[i * 4];
-        // Sprite data is Y+1 logic usually, but OAM storage is Y-1? No, Y
-        // is byte 0. Visible on scanlines Y+1 to Y+8/16. So if scanline >=
-        // y && scanline < y + size
-        int diff = ppu.scanline - y;
-        if (diff >= 0 && diff < sprite_size) {
-          if (count < 8) {
-            // Found a sprite!
-            if (i == 0) {
-              ppu.sprite_zero_hit_possible = true;
-              uint8_t tile = ppu.oam[i * 4 + 1];
-              uint8_t x = ppu.oam[i * 4 + 3];
-              // printf("Sprite 0 Found: Y=%d, Tile=%02X, X=%d\n", y, tile, x);
-            }
-
-            // Copy 4 bytes to Secondary OAM
-            memcpy(&ppu.secondary_oam[count * 4], &ppu.oam[i * 4], 4);
-            count++;
-          } else {
-            // Sprite Overflow
-            ppu.status |= PPU_STATUS_SPR_OVF;
-            break; // In hardware there's a bug, but we can just break for
-                   // now behavior
-          }
-        }
+  ppu_bus_tick(0x3F00);
+}
+
+// Hash of one output row, 8 bytes at a time (rows are 256, 512 or 1024
+// bytes)
+static uint64_t ppu_row_hash(const uint8_t *row, int bytes) {
+  uint64_t h = 0x9E3779B97F4A7C15ULL ^ (uint64_t)bytes;
+  for (int i = 0; i < bytes; i += 8) {
+    uint64_t w;
+    memcpy(&w, row + i, 8);
+    h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 32;
+  }
+  return h;
+}
+
+// Convert the finished line straight into the caller's buffer, then hash the
+// whole row so partly reused lines are tracked too
+static void ppu_output_line(int y) {
+  int start = ppu.line_start;
+  ppu.line_start = 0;
+  if (!ppu.output.pixels)
+    return;
+  if (start < ppu.roi_x0)
+    start = ppu.roi_x0;
+  if (start >= ppu.roi_x1)
+    return;
+
+  int bpp = palette_format_bytes(ppu.output.format);
+  uint8_t *row = (uint8_t *)ppu.output.pixels + (size_t)y * ppu.output.pitch;
+  palette_convert_line_to(ppu.line_pixels + start, row + start * bpp,
+                          ppu.roi_x1 - start, ppu.line_emphasis[y],
+                          ppu.output.format);
+
+  uint64_t h = ppu_row_hash(row, 256 * bpp);
+  if (h != ppu.line_hash[y]) {
+    ppu.line_hash[y] = h;
+    ppu.line_dirty_next[y >> 6] |= 1ULL << (y & 63);
+  }
+}
+
+// --- Dot Phase Table ---
+// What happens on each dot, precomputed per line class so ppu_step() does
+// one table load instead of walking a chain of dot/scanline comparisons.
+enum {
+  PHASE_LINE_VISIBLE, // 0-239
+  PHASE_LINE_IDLE,    // 240, 242-260
+  PHASE_LINE_VBLANK,  // 241
+  PHASE_LINE_PRE,     // 261
+  PHASE_LINE_CLASSES
+};
+
+#define PHASE_LINE_START 0x0001  // Clear secondary OAM, latch emphasis
+#define PHASE_PIXEL 0x0002       // Produce pixel dot - 1
+#define PHASE_LINE_END 0x0004    // Output the finished line
+#define PHASE_SHIFT 0x0008       // Shift BG registers
+#define PHASE_FETCH_NT 0x0010    // Reload shifters, fetch nametable byte
+#define PHASE_FETCH_AT 0x0020    // Fetch attribute byte
+#define PHASE_FETCH_LO 0x0040    // Fetch pattern low byte
+#define PHASE_FETCH_HI 0x0080    // Fetch pattern high byte
+#define PHASE_INC_X 0x0100       // Increment coarse X
+#define PHASE_INC_Y 0x0200       // Increment Y
+#define PHASE_COPY_X 0x0400      // Copy horizontal bits from t
+#define PHASE_COPY_Y 0x0800      // Copy vertical bits from t
+#define PHASE_EVAL 0x1000        // Sprite evaluation for this line
+#define PHASE_SPRITES 0x2000     // Sprite fetch for the next line
+#define PHASE_SPR_CLEAR 0x4000   // Empty the next line's sprites
+#define PHASE_VBLANK 0x8000      // Set VBlank (line 241) or clear flags (261)
+
+// Actions that do not depend on rendering being enabled
+#define PHASE_ALWAYS                                                          \
+  (PHASE_LINE_START | PHASE_PIXEL | PHASE_LINE_END | PHASE_SPR_CLEAR |        \
+   PHASE_VBLANK)
+
+static uint16_t phase_table[PHASE_LINE_CLASSES][341];
+static uint8_t phase_line[262];
+
+static void ppu_phase_build(void) {
+  static bool built = false;
+  if (built)
+    return;
+  built = true;
+
+  for (int sl = 0; sl < 262; sl++) {
+    phase_line[sl] = sl < 240    ? PHASE_LINE_VISIBLE
+                     : sl == 241 ? PHASE_LINE_VBLANK
+                     : sl == 261 ? PHASE_LINE_PRE
+                                 : PHASE_LINE_IDLE;
+  }
+
+  static const uint16_t fetch[8] = {
+      PHASE_FETCH_NT, 0, PHASE_FETCH_AT, 0, PHASE_FETCH_LO,
+      0,              PHASE_FETCH_HI, PHASE_INC_X};
+
+  for (int c = 0; c < PHASE_LINE_CLASSES; c++) {
+    bool fetches = c == PHASE_LINE_VISIBLE || c == PHASE_LINE_PRE;
+    for (int dot = 0; dot <= 340; dot++) {
+      uint16_t a = 0;
+      if (fetches && ((dot >= 1 && dot <= 256) || (dot >= 321 && dot <= 336)))
+        a |= PHASE_SHIFT | fetch[(dot - 1) % 8];
+      if (fetches && dot == 256)
+        a |= PHASE_INC_Y;
+      if (fetches && dot == 257)
+        a |= PHASE_COPY_X;
+      if (fetches && dot == 320)
+        a |= PHASE_SPR_CLEAR;
+      if (c == PHASE_LINE_VISIBLE) {
+        if (dot == 1)
+          a |= PHASE_LINE_START;
+        if (dot >= 1 && dot <= 256)
+          a |= PHASE_PIXEL;
+        if (dot == 256)
+          a |= PHASE_LINE_END;
+        if (dot == 257)
+          a |= PHASE_EVAL;
+        if (dot == 320)
+          a |= PHASE_SPRITES;
       }
-      ppu.sprite_count = count;
+      if (c == PHASE_LINE_PRE && dot >= 280 && dot <= 304)
+        a |= PHASE_COPY_Y;
+      if ((c == PHASE_LINE_PRE || c == PHASE_LINE_VBLANK) && dot == 1)
+        a |= PHASE_VBLANK;
+      phase_table[c][dot] = a;
     }
+  }
+}
 
-    // 3. Sprite Fetching (Cycles 257-320)
-    if (rendering_enabled && ppu.dot == 320) {
-      // Iterate found sprites
-      uint8_t sprite_size = (ppu.ctrl & PPU_CTRL_SPR_SIZE) ? 16 : 8;
-      uint16_t sprite_pattern_table =
-          (ppu.ctrl & PPU_CTRL_SPR_PT) ? 0x1000 : 0x0000;
-
-      for (int i = 0; i < 8; i++) {
-        uint8_t y = ppu.secondary_oam[i * 4 + 0];
-        uint8_t tile = ppu.secondary_oam[i * 4 + 1];
-        uint8_t attr = ppu.secondary_oam[i * 4 + 2];
-        uint8_t x = ppu.secondary_oam[i * 4 + 3];
-
-        // Only process valid sprites for shifters, but ALWAYS fetch
-        bool valid_sprite = (i < ppu.sprite_count);
-
-        if (valid_sprite) {
-          ppu.sprite_x_counter[i] = x;
-          ppu.sprite_attrib[i] = attr;
-        }
+static void ppu_evaluate_sprites(void) {
+  // The occupancy mask already lists every sprite on this line in OAM
+  // order, so evaluation just takes the first 8 set bits.
+  uint64_t hits = ppu.sprite_line_mask[ppu.scanline];
+  int count = 0;
 
-        // Calculate Pattern Address
-        uint16_t addr_lo = 0, addr_hi = 0;
+  while (hits && count < 8) {
+    int i = __builtin_ctzll(hits);
+    if (i == 0) {
+      ppu.sprite_zero_hit_possible = true;
+    }
 
-        // Y-flip logic
-        uint8_t row = ppu.scanline - y;
-        if (attr & 0x80) { // Flip Y
-          row = sprite_size - 1 - row;
-        }
+    // Copy 4 bytes to Secondary OAM
+    memcpy(&ppu.secondary_oam[count * 4], &ppu.oam[i * 4], 4);
+    count++;
+    hits &= hits - 1;
+  }
 
-        if (sprite_size == 8) {
-          // 8x8 Mode
-          uint16_t pt_base = sprite_pattern_table;
-          addr_lo = pt_base + (tile << 4) + row;
-          addr_hi = addr_lo + 8;
-        } else {
-          // 8x16 Mode: Tile LSB determines pattern table
-          uint16_t pt_base = (tile & 0x01) ? 0x1000 : 0x0000;
-          tile &= 0xFE;  // Top tile index
-          if (row < 8) { // Top half
-            addr_lo = pt_base + (tile << 4) + row;
-          } else { // Bottom half
-            addr_lo = pt_base + ((tile + 1) << 4) + (row - 8);
-          }
-          addr_hi = addr_lo + 8;
-        }
+  if (hits) {
+    // Sprite Overflow (a 9th sprite is on this line). In hardware there's
+    // a bug in the overflow search, but we don't emulate it.
+    ppu.status |= PPU_STATUS_SPR_OVF;
+  }
+  ppu.sprite_count = count;
+  if (ppu.stats_enabled) {
+    ppu.stats.sprites_evaluated += count;
+    ppu.stats.overflow_lines += hits != 0;
+  }
+}
 
-        // Read Pattern Data (This drives MMC3 IRQ!)
-        uint8_t pat_lo = ppu_vram_read(addr_lo);
-        uint8_t pat_hi = ppu_vram_read(addr_hi);
-
-        // Horizontal Flip Logic (Flip X)
-        if (attr & 0x40 && valid_sprite) {
-          // Reverse bits
-          uint8_t r_lo = 0, r_hi = 0;
-          for (int b = 0; b < 8; b++) {
-            if (pat_lo & (1 << b))
-              r_lo |= (0x80 >> b);
-            if (pat_hi & (1 << b))
-              r_hi |= (0x80 >> b);
-          }
-          pat_lo = r_lo;
-          pat_hi = r_hi;
-        }
+static void ppu_fetch_sprites(void) {
+  // Iterate found sprites
+  uint8_t sprite_size = (ppu.ctrl & PPU_CTRL_SPR_SIZE) ? 16 : 8;
+  uint16_t sprite_pattern_table =
+      (ppu.ctrl & PPU_CTRL_SPR_PT) ? 0x1000 : 0x0000;
+
+  bool next_in_roi =
+      ppu.scanline + 1 >= ppu.roi_y0 && ppu.scanline + 1 < ppu.roi_y1;
+
+  memset(ppu.sprite_line_buffer, 0, sizeof(ppu.sprite_line_buffer));
+  for (int i = 0; i < ppu.sprite_count; i++) {
+    uint8_t y = ppu.secondary_oam[i * 4 + 0];
+    uint8_t tile = ppu.secondary_oam[i * 4 + 1];
+    uint8_t attr = ppu.secondary_oam[i * 4 + 2];
+    uint8_t x = ppu.secondary_oam[i * 4 + 3];
+
+    // Calculate Pattern Address
+    uint16_t addr_lo = 0, addr_hi = 0;
+
+    // Y-flip logic
+    uint8_t row = ppu.scanline - y;
+    if (attr & 0x80) { // Flip Y
+      row = sprite_size - 1 - row;
+    }
 
-        if (valid_sprite) {
-          ppu.sprite_shifter_pattern_lo[i] = pat_lo;
-          ppu.sprite_shifter_pattern_hi[i] = pat_hi;
-        }
+    if (sprite_size == 8) {
+      // 8x8 Mode
+      uint16_t pt_base = sprite_pattern_table;
+      addr_lo = pt_base + (tile << 4) + row;
+      addr_hi = addr_lo + 8;
+    } else {
+      // 8x16 Mode: Tile LSB determines pattern table
+      uint16_t pt_base = (tile & 0x01) ? 0x1000 : 0x0000;
+      tile &= 0xFE;  // Top tile index
+      if (row < 8) { // Top half
+        addr_lo = pt_base + (tile << 4) + row;
+      } else { // Bottom half
+        addr_lo = pt_base + ((tile + 1) << 4) + (row - 8);
       }
+      addr_hi = addr_lo + 8;
+    }
+
+    // Read Pattern Data (This drives MMC3 IRQ!)
+    uint8_t pat_lo = ppu_vram_read(addr_lo);
+    uint8_t pat_hi = ppu_vram_read(addr_hi);
+
+    // Horizontal Flip Logic (Flip X)
+    if (attr & 0x40) {
+      pat_lo = bit_reverse[pat_lo];
+      pat_hi = bit_reverse[pat_hi];
+    }
 
-      // Latch sprite count for next line rendering
-      ppu.render_sprite_count = ppu.sprite_count;
-      ppu.render_sprite_zero_possible = ppu.sprite_zero_hit_possible;
+    // Skipped frames and lines outside the render region only need
+    // sprite 0's opacity for the hit test
+    if ((!ppu.frame_skip && !ppu.defer_job && next_in_roi) ||
+        (i == 0 && ppu.sprite_zero_hit_possible)) {
+      ppu_paint_sprite(i, x, attr, pat_lo, pat_hi);
     }
   }
 
-  // Visible Scanlines (0-239) or Pre-render (261)
-  if (ppu.scanline <= 239 || ppu.scanline == 261) {
+  // Empty slots still fetch tile $FF so the mapper sees the same A12
+  // pattern as hardware. Only the address matters, so skip the read.
+  uint16_t dummy_addr =
+      (sprite_size == 8) ? (sprite_pattern_table | 0x0FF0) : 0x1FF0;
+  for (int i = ppu.sprite_count; i < 8; i++) {
+    ppu_bus_tick(dummy_addr);
+    ppu_bus_tick(dummy_addr | 0x0008);
+  }
+}
 
-    // Background Cycle Loop (Fetches every 8 cycles)
-    if (ppu.scanline == 261 && ppu.dot == 1) {
-      // Clear VBlank
-      ppu.status &=
-          ~(PPU_STATUS_VBLANK | PPU_STATUS_SPR0_HIT | PPU_STATUS_SPR_OVF);
+// Rendering on: pixels [pixel_x, end) of the line, composited from the BG
+// shifters as they stood at pixel_x and the sprites painted into the line
+// buffer at dot 320 of the previous line. `mask` is a compile-time constant
+// in each case of ppu_pixel_flush, so the show and left-clip tests fold away.
+// Each dot's palette fetch already reached the mapper, so palette RAM is read
+// directly.
+static inline __attribute__((always_inline)) void
+ppu_composite(int x0, int end, const uint8_t mask) {
+  uint16_t pattern_lo = ppu.pixel_shifters[0];
+  uint16_t pattern_hi = ppu.pixel_shifters[1];
+  uint16_t attrib_lo = ppu.pixel_shifters[2];
+  uint16_t attrib_hi = ppu.pixel_shifters[3];
+  // Shifters shift left, so the current pixel is bit (15 - fine_x)
+  uint16_t bit_mux = 0x8000 >> ppu.fine_x;
+  uint8_t color_mask = ppu_color_mask();
+
+  for (int x = x0; x < end; x++) {
+    uint8_t pixel = 0;
+    uint8_t palette = 0;
+
+    if (mask & PPU_MASK_SHOW_BG) {
+      uint8_t p0 = (pattern_lo & bit_mux) ? 1 : 0;
+      uint8_t p1 = (pattern_hi & bit_mux) ? 1 : 0;
+      pixel = (p1 << 1) | p0; // 0-3
+
+      uint8_t pal0 = (attrib_lo & bit_mux) ? 1 : 0;
+      uint8_t pal1 = (attrib_hi & bit_mux) ? 1 : 0;
+      palette = (pal1 << 1) | pal0; // 0-3
+
+      // Left Clipping (BG)
+      if ((mask & PPU_MASK_SHOW_BG_LEFT) == 0 && x < 8) {
+        pixel = 0;
+        palette = 0;
+      }
+
+      pattern_lo <<= 1;
+      pattern_hi <<= 1;
+      attrib_lo <<= 1;
+      attrib_hi <<= 1;
     }
 
-    // Cycle 1-256 (Visible) + 321-336 (Prefetch)
-    if (rendering_enabled && ((ppu.dot >= 1 && ppu.dot <= 256) ||
-                              (ppu.dot >= 321 && ppu.dot <= 336))) {
+    // --- Sprite Pixel Logic ---
+    uint8_t sprite = 0;
+    if (mask & PPU_MASK_SHOW_SPR) {
+      sprite = ppu.sprite_line_buffer[x];
 
-      ppu_update_shifters();
+      // Left Clipping (Sprite)
+      if ((mask & PPU_MASK_SHOW_SPR_LEFT) == 0 && x < 8) {
+        sprite = 0;
+      }
+    }
 
-      // 8-step cadence
-      switch ((ppu.dot - 1) % 8) {
-      case 0: // Load shifters, Fetch NT
-        ppu_load_bg_shifters();
-        // Fetch NT Byte
-        ppu.bg_next_tile_id = ppu_vram_read(0x2000 | (ppu.v & 0x0FFF));
-        break;
-      case 2: // Fetch AT Byte
-      {
-        // Attribute Logic is complex: address 23C0 + (v.NN 1111 YYY XXX)
-        // v: ...NN.. ...YYYXXX
-        // AT: 0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07)
-        uint16_t at_addr = 0x23C0 | (ppu.v & 0x0C00) | ((ppu.v >> 4) & 0x38) |
-                           ((ppu.v >> 2) & 0x07);
-        ppu.bg_next_tile_attrib = ppu_vram_read(at_addr);
-
-        // Parse appropriate quadrant
-        if (ppu.v & 0x40)
-          ppu.bg_next_tile_attrib >>= 4; // Bottom
-        if (ppu.v & 0x02)
-          ppu.bg_next_tile_attrib >>= 2; // Right
-        ppu.bg_next_tile_attrib &= 0x03;
-      } break;
-      case 4: // Fetch Low BG Byte
-        // Pattern Table Addr = (Ctrl.4 << 12) + (TileID * 16) + FineY
-        {
-          uint16_t pt_addr = ((ppu.ctrl & PPU_CTRL_BG_PT) ? 0x1000 : 0x0000) +
-                             ((uint16_t)ppu.bg_next_tile_id << 4) +
-                             ((ppu.v >> 12) & 0x07);
-          ppu.bg_next_tile_lsb = ppu_vram_read(pt_addr);
-        }
-        break;
-      case 6: // Fetch High BG Byte
-      {
-        uint16_t pt_addr = ((ppu.ctrl & PPU_CTRL_BG_PT) ? 0x1000 : 0x0000) +
-                           ((uint16_t)ppu.bg_next_tile_id << 4) +
-                           ((ppu.v >> 12) & 0x07) + 8;
-        ppu.bg_next_tile_msb = ppu_vram_read(pt_addr);
-      } break;
-      case 7: // Increment Scroll X
-        ppu_increment_scroll_x();
-        break;
+    // --- Multiplexing ---
+    // Palette RAM: $3F00 + (Palette * 4) + Pixel, sprites use $3F10-$3F1F
+    uint16_t pal_addr = 0x3F00;
+
+    if (pixel != 0 && sprite != 0) {
+      // Sprite 0 Hit: opaque sprite 0 over opaque BG, never at x=255
+      if ((sprite & SPRITE_PIXEL_ZERO) && x != 255) {
+        ppu_stats_sprite0(x);
+        ppu.status |= PPU_STATUS_SPR0_HIT;
+      }
+
+      if (sprite & SPRITE_PIXEL_BEHIND) { // Behind BG
+        pal_addr = 0x3F00 | (palette << 2) | pixel;
+      } else { // In Front of BG
+        pal_addr = 0x3F10 | (sprite & 0x0F);
       }
+    } else if (sprite != 0) {
+      pal_addr = 0x3F10 | (sprite & 0x0F);
+    } else if (pixel != 0) {
+      pal_addr = 0x3F00 | (palette << 2) | pixel;
     }
 
-    // Start of Scanline Log
-    if (ppu.dot == 0 && ppu.scanline < 240) {
-      static int frame_log_count = 0;
-      if (frame_log_count < 2) { // Log first 2 frames only
-        // printf("SL:%d v:%04X t:%04X x:%d\n", ppu.scanline, ppu.v, ppu.t,
-        //        ppu.fine_x);
+    ppu.line_pixels[x] = ppu.palette[ppu_palette_index(pal_addr)] & color_mask;
+  }
+}
+
+// Composite the pending pixels with the loop specialized for PPUMASK bits 1-4
+// (BG/sprite show and left-column clip). Runs end before the shifters reload
+// and before any register access, so the mask, fine X, palette and sprite
+// buffer cannot have changed since the run began.
+static void ppu_pixel_flush(int end) {
+#define PIXEL_CASE(n)                                                         \
+  case n:                                                                     \
+    ppu_composite(ppu.pixel_x, end, (n) << 1);                                \
+    break;
+  switch ((ppu.mask >> 1) & 0x0F) {
+    PIXEL_CASE(0)
+    PIXEL_CASE(1)
+    PIXEL_CASE(2)
+    PIXEL_CASE(3)
+    PIXEL_CASE(4)
+    PIXEL_CASE(5)
+    PIXEL_CASE(6)
+    PIXEL_CASE(7)
+    PIXEL_CASE(8)
+    PIXEL_CASE(9)
+    PIXEL_CASE(10)
+    PIXEL_CASE(11)
+    PIXEL_CASE(12)
+    PIXEL_CASE(13)
+    PIXEL_CASE(14)
+    PIXEL_CASE(15)
+  }
+#undef PIXEL_CASE
+  ppu.pixel_x = -1;
+}
+
+// Rendering on/off only changes on PPUMASK writes, so it is resolved here
+// instead of on every dot
+static void ppu_select_mode(void) {
+  bool rendering_enabled = ppu.mask & (PPU_MASK_SHOW_BG | PPU_MASK_SHOW_SPR);
+  ppu.phase_mask = rendering_enabled ? 0xFFFF : PHASE_ALWAYS;
+}
+
+// --- Sprite 0 Hit Prediction ---
+
+// Opaque BG pixel at column x of visible line `line`, for a frame that
+// starts from the current t, fine X, PPUCTRL and VRAM contents
+static bool ppu_predict_bg_opaque(int line, int x) {
+  uint16_t v = ppu.t;
+  for (int i = 0; i < line; i++)
+    v = ppu_scroll_y_next(v);
+
+  // The line's first tile is the one prefetched at coarse X from t
+  int pos = ppu.fine_x + x;
+  int coarse = (v & 0x001F) + (pos >> 3);
+  uint16_t nt = v & 0x0C00;
+  if (coarse >= 32) {
+    coarse -= 32;
+    nt ^= 0x0400;
+  }
+  uint16_t nt_addr = 0x2000 | nt | (v & 0x03E0) | coarse;
+  uint8_t tile = *ppu_nametable_ptr(nt_addr);
+
+  uint16_t pt_addr = ((ppu.ctrl & PPU_CTRL_BG_PT) ? 0x1000 : 0x0000) +
+                     ((uint16_t)tile << 4) + ((v >> 12) & 0x07);
+  uint8_t bit = 0x80 >> (pos & 7);
+  return ((ppu_chr_read(pt_addr) | ppu_chr_read(pt_addr + 8)) & bit) != 0;
+}
+
+bool ppu_predict_sprite0_hit(int *scanline, int *dot) {
+  const uint8_t both = PPU_MASK_SHOW_BG | PPU_MASK_SHOW_SPR;
+  const uint8_t both_left = PPU_MASK_SHOW_BG_LEFT | PPU_MASK_SHOW_SPR_LEFT;
+
+  // Only from VBlank up to the pre-render line's X copy, while the next
+  // frame's scroll still comes entirely from t
+  if (ppu.scanline < 240 || (ppu.scanline == 261 && ppu.dot >= 257))
+    return false;
+  if ((ppu.mask & both) != both)
+    return false;
+
+  uint8_t sy = ppu.oam[0], tile = ppu.oam[1], attr = ppu.oam[2];
+  uint8_t sx = ppu.oam[3];
+  int height = (ppu.ctrl & PPU_CTRL_SPR_SIZE) ? 16 : 8;
+  int first_x = ((ppu.mask & both_left) == both_left) ? 0 : 8;
+
+  // A sprite evaluated on line L is drawn on line L + 1; line 0 never shows
+  // sprites and line 239 has no line after it
+  for (int row = 0; row < height; row++) {
+    int line = sy + row + 1;
+    if (line > 239)
+      break;
+
+    int r = (attr & 0x80) ? height - 1 - row : row;
+    uint16_t addr;
+    if (height == 8) {
+      addr = ((ppu.ctrl & PPU_CTRL_SPR_PT) ? 0x1000 : 0x0000) + (tile << 4) + r;
+    } else {
+      uint16_t pt_base = (tile & 0x01) ? 0x1000 : 0x0000;
+      addr = pt_base + (((tile & 0xFE) + (r >= 8)) << 4) + (r & 7);
+    }
+    uint8_t bits = ppu_chr_read(addr) | ppu_chr_read(addr + 8);
+    if (!bits)
+      continue;
+
+    for (int b = 0; b < 8; b++) {
+      int x = sx + b;
+      if (x >= 255)
+        break;
+      uint8_t mask_bit = (attr & 0x40) ? (0x01 << b) : (0x80 >> b);
+      if (x < first_x || !(bits & mask_bit))
+        continue;
+      if (ppu_predict_bg_opaque(line, x)) {
+        *scanline = line;
+        *dot = x + 1;
+        return true;
       }
     }
+  }
+  return false;
+}
 
-    // Cycle 256: Increment Y
-    if (rendering_enabled && ppu.dot == 256) {
-      ppu_increment_scroll_y();
+void ppu_step(void) {
+  // Inside a run of backdrop pixels nothing else happens until dot 256
+  if (ppu.idle_x >= 0 && ppu.dot >= 2 && ppu.dot <= 255) {
+    ppu.dot++;
+    return;
+  }
+
+  if (ppu.reuse_active) {
+    ppu_reuse_check();
+  }
+
+  uint16_t act =
+      phase_table[phase_line[ppu.scanline]][ppu.dot] & ppu.phase_mask;
+
+  if (act) {
+    if (act & PHASE_LINE_START) {
+      // Secondary OAM clear takes cycles 1-64 in hardware. Instant here.
+      memset(ppu.secondary_oam, 0xFF, sizeof(ppu.secondary_oam));
+      ppu.sprite_count = 0;
+      ppu.sprite_zero_hit_possible = false;
+      // Emphasis is applied per line when indices are converted to RGB
+      ppu.line_emphasis[ppu.scanline] = ppu.mask >> 5;
+      ppu.line_in_roi =
+          ppu.scanline >= ppu.roi_y0 && ppu.scanline < ppu.roi_y1;
     }
 
-    // Cycle 257: Reset X (Load from t)
-    if (rendering_enabled && ppu.dot == 257) {
-      ppu_load_bg_shifters(); // Just in case? Usually done at dot 1? No 257
-                              // just resets X
-      ppu_transfer_address_x();
+    if (act & PHASE_EVAL)
+      ppu_evaluate_sprites();
+
+    // Lines without a sprite fetch (pre-render, rendering off) leave the next
+    // line empty, so line 0 never shows sprites
+    if (act & PHASE_SPRITES)
+      ppu_fetch_sprites();
+    else if (act & PHASE_SPR_CLEAR)
+      memset(ppu.sprite_line_buffer, 0, sizeof(ppu.sprite_line_buffer));
+
+    if ((act & PHASE_VBLANK) && ppu.scanline == 261) {
+      ppu.status &=
+          ~(PPU_STATUS_VBLANK | PPU_STATUS_SPR0_HIT | PPU_STATUS_SPR_OVF);
     }
 
-    // Cycle 338 or 340? Dummy fetches (skipped for simple implementation)
+    // Background fetches on an 8-dot cadence (dots 1-256 and the 321-336
+    // prefetch)
+    if (act & PHASE_SHIFT)
+      ppu_update_shifters();
 
-    // Pre-render Cycle 280-304: Reset Y (Load from t)
-    if (rendering_enabled && ppu.scanline == 261 && ppu.dot >= 280 &&
-        ppu.dot <= 304) {
-      ppu_transfer_address_y();
+    if (act & PHASE_FETCH_NT) {
+      ppu_load_bg_shifters();
+      ppu.bg_next_tile_id = ppu_vram_read(0x2000 | (ppu.v & 0x0FFF));
+    } else if (act & PHASE_FETCH_AT) {
+      // The tile's palette comes from the attribute shadow; the address
+      // 0x23C0 | (v & 0x0C00) | ((v >> 4) & 0x38) | ((v >> 2) & 0x07) is
+      // only presented to the mapper
+      ppu_bus_tick(0x23C0 | (ppu.v & 0x0C00) | ((ppu.v >> 4) & 0x38) |
+                   ((ppu.v >> 2) & 0x07));
+      ppu.bg_next_tile_attrib =
+          ppu.at_page[(ppu.v >> 10) & 0x03][ppu.v & 0x03FF];
+    } else if (act & (PHASE_FETCH_LO | PHASE_FETCH_HI)) {
+      // Pattern Table Addr = (Ctrl.4 << 12) + (TileID * 16) + FineY
+      uint16_t pt_addr = ((ppu.ctrl & PPU_CTRL_BG_PT) ? 0x1000 : 0x0000) +
+                         ((uint16_t)ppu.bg_next_tile_id << 4) +
+                         ((ppu.v >> 12) & 0x07);
+      if (act & PHASE_FETCH_LO)
+        ppu.bg_next_tile_lsb = ppu_vram_read(pt_addr);
+      else
+        ppu.bg_next_tile_msb = ppu_vram_read(pt_addr + 8);
+    } else if (act & PHASE_INC_X) {
+      ppu_increment_scroll_x();
     }
 
-    // --- Pixel Output (To Framebuffer) ---
-    // Only if rendering enabled and visible period
-    if (ppu.scanline < 240 && ppu.dot >= 1 && ppu.dot <= 256) {
-      // Check if rendering is actually enabled
-      if (!(ppu.mask & (PPU_MASK_SHOW_BG | PPU_MASK_SHOW_SPR))) {
-        // Rendering disabled - output backdrop color
-        int x = ppu.dot - 1;
-        int y = ppu.scanline;
-        ppu.display_buffer[y * 256 + x] = ppu_vram_read(0x3F00) & 0x3F;
+    if (act & PHASE_INC_Y)
+      ppu_increment_scroll_y();
+
+    if (act & PHASE_COPY_X) {
+      ppu_load_bg_shifters();
+      ppu_transfer_address_x();
+    }
+
+    if (act & PHASE_COPY_Y)
+      ppu_transfer_address_y();
+
+    // --- Pixel Output ---
+    if (act & PHASE_PIXEL) {
+      bool backdrop_line = false;
+
+      if (ppu.phase_mask == PHASE_ALWAYS && !ppu.reuse_active) {
+        // Rendering disabled - start (or end) a run of backdrop pixels
+        if (ppu.idle_x < 0) {
+          ppu.idle_x = ppu.dot - 1;
+          ppu_bus_tick(0x3F00);
+        }
+        if (act & PHASE_LINE_END) {
+          backdrop_line = ppu.idle_x == 0;
+          ppu_idle_flush(256);
+        }
+      } else if (ppu.frame_skip || ppu.reuse_active || ppu.defer_job ||
+                 !ppu.line_in_roi || ppu.dot <= ppu.roi_x0 ||
+                 ppu.dot > ppu.roi_x1) {
+        if (ppu.pixel_x >= 0)
+          ppu_pixel_flush(ppu.dot - 1);
+        ppu_skip_pixel(ppu.dot - 1);
       } else {
-        // Rendering enabled - process pixels normally
-        uint8_t pixel = 0;
-        uint8_t palette = 0;
-
-        if (ppu.mask & PPU_MASK_SHOW_BG) {
-          // De-mux shifter bits using fine_x
-          // Bit 15 is leftmost. 15 - fine_x is the bit we want?
-          // Actually shifters shift LEFT. So MSB is current pixel.
-          // We need to pick bit (15 - fine_x)
-          uint16_t bit_mux = 0x8000 >> ppu.fine_x;
-
-          uint8_t p0 = (ppu.bg_shifter_pattern_lo & bit_mux) ? 1 : 0;
-          uint8_t p1 = (ppu.bg_shifter_pattern_hi & bit_mux) ? 1 : 0;
-          pixel = (p1 << 1) | p0; // 0-3
-
-          uint8_t pal0 = (ppu.bg_shifter_attrib_lo & bit_mux) ? 1 : 0;
-          uint8_t pal1 = (ppu.bg_shifter_attrib_hi & bit_mux) ? 1 : 0;
-          palette = (pal1 << 1) | pal0; // 0-3
-
-          // Left Clipping (BG)
-          if ((ppu.mask & PPU_MASK_SHOW_BG_LEFT) == 0) {
-            if (ppu.dot <= 8) {
-              pixel = 0;
-              palette = 0;
-            }
-          }
+        // Pixels are composited in runs that end at the next shifter reload
+        // (every 8 dots), so the shifters are saved as the run opens
+        if (ppu.pixel_x < 0) {
+          ppu.pixel_x = ppu.dot - 1;
+          ppu.pixel_shifters[0] = ppu.bg_shifter_pattern_lo;
+          ppu.pixel_shifters[1] = ppu.bg_shifter_pattern_hi;
+          ppu.pixel_shifters[2] = ppu.bg_shifter_attrib_lo;
+          ppu.pixel_shifters[3] = ppu.bg_shifter_attrib_hi;
+        }
+        ppu_bus_tick(0x3F00);
+        if ((ppu.dot & 0x07) == 0)
+          ppu_pixel_flush(ppu.dot);
+      }
 
-          // --- Sprite Pixel Logic ---
-          uint8_t sprite_pixel = 0;
-          uint8_t sprite_palette = 0;
-          bool sprite_priority = false; // 0=Front, 1=Back
-
-          if (ppu.mask & PPU_MASK_SHOW_SPR) {
-            // Check all active sprites
-            for (int i = 0; i < ppu.render_sprite_count; i++) {
-              if (ppu.sprite_x_counter[i] == 0) {
-                // Sprite is active at this X
-                // Check bit 7 (MSB) of shifter? Sprites shifters don't shift
-                // endlessly? Actually sprite pattern is loaded, and as X
-                // counter hits 0, we output pixels? Wait, X counter
-                // determines START position. Once started, we output 8
-                // pixels. My logic: X counter decrements until 0. Then we use
-                // shifter? Standard: Counter decrements. If 0, shift out
-                // pixel.
-
-                uint8_t pixel_lo =
-                    (ppu.sprite_shifter_pattern_lo[i] & 0x80) ? 1 : 0;
-                uint8_t pixel_hi =
-                    (ppu.sprite_shifter_pattern_hi[i] & 0x80) ? 1 : 0;
-                uint8_t sp_pix = (pixel_hi << 1) | pixel_lo;
-
-                if (sp_pix != 0) {
-                  // Left Clipping (Sprite)
-                  if ((ppu.mask & PPU_MASK_SHOW_SPR_LEFT) == 0) {
-                    if (ppu.dot <= 8) {
-                      sp_pix = 0;
-                    }
-                  }
-
-                  if (sp_pix != 0) {
-                    if (sprite_pixel ==
-                        0) { // First non-transparent sprite wins
-                      sprite_pixel = sp_pix;
-                      sprite_palette = (ppu.sprite_attrib[i] & 0x03) + 4;
-                      sprite_priority =
-                          (ppu.sprite_attrib[i] & 0x20) ? true : false;
-
-                      // Sprite 0 Hit
-                      if (i == 0 && ppu.render_sprite_zero_possible) {
-                        if (pixel != 0 && sp_pix != 0) {
-                          // Require BG pixel to be opaque too
-                          // Hit not possible if clipped? Already handled by
-                          // setting 0.
-                          if (ppu.dot != 255) {
-                            ppu.status |= PPU_STATUS_SPR0_HIT; // Set flag
-                            ppu.sprite_zero_being_rendered =
-                                true; // Mark potential hit
-                          }
-                        }
-                      }
-                    }
-                  }
-                }
-
-                // Shift
-                ppu.sprite_shifter_pattern_lo[i] <<= 1;
-                ppu.sprite_shifter_pattern_hi[i] <<= 1;
-              } else {
-                ppu.sprite_x_counter[i]--;
-              }
-            }
-          }
+      if (act & PHASE_LINE_END) {
+        if (ppu.stats_enabled) {
+          if (ppu.frame_skip || ppu.defer_job || !ppu.line_in_roi)
+            ppu.stats.lines_skipped++;
+          else if (backdrop_line || ppu.reuse_active)
+            ppu.stats.lines_fast++;
+          else
+            ppu.stats.lines_accurate++;
+        }
 
-          // --- Multiplexing ---
-          uint8_t final_pixel = 0;
-          uint8_t final_palette = 0;
-
-          if (pixel != 0 && sprite_pixel != 0) {
-            // Collision!
-            if (ppu.sprite_zero_being_rendered) {
-              // Confirm BG pixel is valid for hit
-              if (pixel != 0 && ppu.scanline != 255) { // Hit!
-                ppu.status |= PPU_STATUS_SPR0_HIT;
-              }
-            }
-
-            if (sprite_priority) { // Behind BG
-              final_pixel = pixel;
-              final_palette = palette;
-            } else { // In Front of BG
-              final_pixel = sprite_pixel;
-              final_palette = sprite_palette;
-            }
-          } else if (sprite_pixel != 0) {
-            final_pixel = sprite_pixel;
-            final_palette = sprite_palette;
-          } else {
-            final_pixel = pixel;
-            final_palette = palette;
+        if (!ppu.frame_skip && !ppu.defer_job) {
+          if (!ppu.reuse_active) {
+            if (ppu.line_in_roi)
+              ppu_output_line(ppu.scanline);
+            else
+              ppu.line_start = 0;
+          } else if (ppu.scanline == 239) {
+            // Every visible pixel matched: the target already holds this
+            // frame
+            ppu.reuse_matched = true;
+            ppu.reuse_active = false;
           }
-
-          // Compose final palette index
-          // Palette RAM: $3F00 + (Palette * 4) + Pixel
-          uint16_t pal_addr = 0x3F00 | (final_palette << 2) | final_pixel;
-          if (final_pixel == 0)
-            pal_addr = 0x3F00;
-
-          uint8_t color_index = ppu_vram_read(pal_addr) & 0x3F;
-
-          // Write to framebuffer
-          // scanline 0-239
-          // dot 1-256 -> x 0-255
-          int x = ppu.dot - 1;
-          int y = ppu.scanline;
-          // Ensure bounds (should be safe by checks)
-          ppu.display_buffer[y * 256 + x] = color_index;
         }
       }
     }
-  }
 
-  // VBlank Set (Moved outside because scanline 241 is not <= 239)
-  if (ppu.scanline == 241 && ppu.dot == 1) {
-    ppu.status |= PPU_STATUS_VBLANK;
-    if (ppu.ctrl & PPU_CTRL_NMI) {
-      cpu_nmi();
+    if ((act & PHASE_VBLANK) && ppu.scanline == 241) {
+      ppu.status |= PPU_STATUS_VBLANK;
+      if (ppu.ctrl & PPU_CTRL_NMI) {
+        ppu_timeline(TIMELINE_NMI, 0, 0);
+        cpu_nmi();
+      }
     }
   }
 
@@ -651,19 +1410,107 @@ void ppu_step(void) {
     ppu.dot = 0;
     ppu.scanline++;
 
+    if (ppu.scanline == 240) {
+      if (ppu.defer_job)
+        ppu_defer_end();
+      ppu_latch_frame_settings();
+    }
+
     if (ppu.scanline > 261) {
       ppu.scanline = 0;
       ppu.frame_complete = true;
+      ppu_frame_begin();
     }
   }
 }
 
-const uint8_t *ppu_get_framebuffer(void) { return ppu.display_buffer; }
+void ppu_set_output(void *pixels, int pitch, uint8_t format) {
+  if (pixels != ppu.output.pixels || pitch != ppu.output.pitch ||
+      format != ppu.output.format)
+    ppu.output_changed = true;
+  ppu.output.pixels = pixels;
+  ppu.output.pitch = pitch;
+  ppu.output.format = format;
+}
+
+const PPU_OutputTarget *ppu_get_output(void) { return &ppu.output; }
+
+void ppu_set_frame_skip(bool skip) { ppu.frame_skip_next = skip; }
+
+void ppu_set_render_region(int x0, int y0, int x1, int y1) {
+  x0 = x0 < 0 ? 0 : x0 > 256 ? 256 : x0;
+  x1 = x1 < x0 ? x0 : x1 > 256 ? 256 : x1;
+  y0 = y0 < 0 ? 0 : y0 > 240 ? 240 : y0;
+  y1 = y1 < y0 ? y0 : y1 > 240 ? 240 : y1;
+  ppu.roi_next[0] = x0;
+  ppu.roi_next[1] = y0;
+  ppu.roi_next[2] = x1;
+  ppu.roi_next[3] = y1;
+}
 
 const uint8_t *ppu_get_palette(void) { return ppu.palette; }
 
+const uint8_t *ppu_get_emphasis(void) { return ppu.line_emphasis; }
+
 bool ppu_is_frame_complete(void) { return ppu.frame_complete; }
 
 void ppu_clear_frame_complete(void) { ppu.frame_complete = false; }
 
 int ppu_get_scanline(void) { return ppu.scanline; }
+
+void ppu_set_deferred(bool enable) {
+  if (!enable)
+    ppu_defer_drop();
+  ppu.deferred = enable;
+}
+
+static void ppu_replay_event(PPU_FrameJob *job, const PPU_Event *ev) {
+  switch (ev->kind) {
+  case PPU_EVENT_WRITE:
+    ppu_write_reg(ev->addr, ev->value);
+    break;
+  case PPU_EVENT_READ:
+    (void)ppu_read_reg(ev->addr);
+    break;
+  case PPU_EVENT_DMA:
+    ppu_oam_dma(job->dma[ev->addr]);
+    break;
+  case PPU_EVENT_MIRRORING:
+    ppu_set_mirroring(ev->value);
+    break;
+  case PPU_EVENT_CHR_BANKS:
+    ppu_set_chr_banks(job->chr_banks[ev->addr]);
+    break;
+  }
+}
+
+void ppu_render_job(PPU_FrameJob *job, const PPU_OutputTarget *output,
+                    uint64_t *line_hash) {
+  PPU_State *caller = ppu_cur;
+  ppu_cur = &job->start;
+
+  ppu.replay = true;
+  ppu.deferred = false;
+  ppu.stats_enabled = false;
+  if (ppu.rom && ppu.rom->is_chr_ram && ppu.chr_data)
+    ppu.chr_data = job->chr_ram;
+  ppu_chr_map();
+  ppu.output = *output;
+  ppu.frame_skip = false;
+  ppu.reuse_enabled = false;
+  ppu.reuse_active = false;
+  ppu.line_start = 0;
+  memcpy(ppu.line_hash, line_hash, sizeof(ppu.line_hash));
+  ppu_set_mirroring(ppu.mirroring); // Point the pages at this copy's VRAM
+
+  int e = 0;
+  while (ppu.scanline < 240) {
+    while (e < job->event_count && job->events[e].pos <= ppu_frame_pos()) {
+      ppu_replay_event(job, &job->events[e++]);
+    }
+    ppu_step();
+  }
+
+  memcpy(line_hash, ppu.line_hash, sizeof(ppu.line_hash));
+  ppu_cur = caller;
+}
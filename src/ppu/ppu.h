@@ -1,6 +1,7 @@
 #ifndef PPU_H
 #define PPU_H
 
+#include "palette.h"
 #include "rom.h"
 #include <stdbool.h>
 #include <stdint.h>
@@ -26,13 +27,123 @@
 #define PPU_STATUS_SPR0_HIT 0x40
 #define PPU_STATUS_SPR_OVF 0x20
 
+// Register accesses journaled per frame for static-screen reuse
+#define PPU_JOURNAL_SIZE 1024
+
+// Deferred rendering: per-frame limits of a recorded job. A job records
+// lines 0-239, 240 * 341 / 3 = 27280 CPU cycles. The CPU core makes no dummy
+// accesses, so the densest stream is a read-modify-write on a register
+// (INC $2007: one read and one write in 6 cycles), 9094 events, plus at most
+// 256 CHR bank switches and 8 DMAs. Past a limit the job is flagged
+// overflowed and further events are dropped: the replayed picture may be
+// inexact (logged once), while the live PPU state is unaffected.
+#define PPU_DEFER_EVENTS 16384
+#define PPU_DEFER_DMA 8
+#define PPU_DEFER_CHR_BANKS 256
+#define PPU_DEFER_CHR_RAM 8192 // CHR-RAM boards carry 8KB (see rom.c)
+
+// Kinds of recorded CPU-side events
+#define PPU_EVENT_WRITE 0     // Register write (addr, value)
+#define PPU_EVENT_READ 1      // $2002/$2007 read: updates w, v, read buffer
+#define PPU_EVENT_DMA 2       // OAM DMA; addr indexes the job's DMA pages
+#define PPU_EVENT_MIRRORING 3 // Mirroring change (value)
+#define PPU_EVENT_CHR_BANKS 4 // CHR bank switch; addr indexes the bank sets
+
+typedef struct PPU_FrameJob PPU_FrameJob;
+
+// Per-frame instrumentation, counted while enabled with ppu_set_stats()
+typedef struct {
+  uint32_t frame;          // Frames completed since counting started
+  uint32_t reg_writes[8];  // CPU writes to $2000-$2007
+  uint32_t midline_writes; // Register writes on dots 1-256 of lines 0-239
+  uint32_t vram_bytes;     // Bytes read or written through $2007
+  uint32_t oam_dmas;
+  uint32_t sprites_evaluated; // Sprites copied to secondary OAM
+  uint32_t overflow_lines;    // Lines with more than 8 sprites
+  int16_t sprite0_line;       // Where sprite 0 hit was set, -1 if not
+  int16_t sprite0_dot;
+  // Visible lines by how their pixels were produced: composited per dot,
+  // painted as one backdrop run or kept from the previous frame, or not
+  // produced (frame skip, or handed to the render thread)
+  uint32_t lines_accurate;
+  uint32_t lines_fast;
+  uint32_t lines_skipped;
+} PPU_FrameStats;
+
+// Where finished scanlines are written. `pitch` is the row size in bytes and
+// `format` a PALETTE_FORMAT_* value; pixels == NULL disables video output.
+typedef struct {
+  void *pixels;
+  int pitch;
+  uint8_t format;
+} PPU_OutputTarget;
+
 typedef struct {
   // VRAM (16KB total address space mapped here mostly via cartridge or internal
   // NT) Physical VRAM usually 2KB or 4KB for Nametables. CHR ROM/RAM is
   // normally mapped from Cartridge. We will use pointers to map different
   // regions.
-  uint8_t display_buffer[256 * 240]; // Output pixel buffer (indices or RGB?)
-                                     // Let's use indices.
+  uint8_t line_pixels[256];   // Palette indices of the line being drawn
+  uint8_t line_emphasis[240]; // PPUMASK emphasis bits (mask >> 5) per line
+  int16_t idle_x; // First backdrop pixel not yet painted (rendering off), -1
+  int16_t pixel_x; // First pixel not yet composited (rendering on), -1
+  uint16_t pixel_shifters[4]; // BG shifters as pixel_x was produced
+
+  // Derived from PPUMASK on every write (see ppu_select_mode): the phase
+  // table actions allowed
+  uint16_t phase_mask;
+
+  // Instrumentation
+  bool stats_enabled;
+  PPU_FrameStats stats;      // Current frame
+  PPU_FrameStats stats_last; // Last completed frame
+
+  // Output target (caller-owned), filled one line at a time at dot 256
+  PPU_OutputTarget output;
+  bool frame_skip;      // Produce no pixels, keep every other side effect
+  bool frame_skip_next; // Requested for the next frame, latched at line 240
+  // Render region: only pixels in columns [roi_x0, roi_x1) of lines
+  // [roi_y0, roi_y1) are composited and written to the target
+  int16_t roi_x0, roi_x1, roi_y0, roi_y1;
+  int16_t roi_next[4]; // Requested x0, y0, x1, y1, latched at line 240
+  bool line_in_roi; // Current line is inside the region
+
+  // Per-line change tracking: hash of each output row's bytes and a 240-bit
+  // mask of rows whose hash changed, for the last completed frame
+  uint64_t line_hash[240];
+  uint64_t line_dirty[4];
+  uint64_t line_dirty_next[4]; // Being built for the current frame
+
+  // Static-Screen Reuse
+  // CPU accesses that change a rendering input are journaled with their
+  // position in the frame. A frame starting from the same inputs as the
+  // previous one keeps the previous pixels in the output target until its
+  // journal first differs, and renders normally from that dot on.
+  bool reuse_enabled;
+  bool reuse_active;        // Current frame still matches the previous one
+  bool reuse_matched;       // Current frame matched through line 239
+  bool frame_reused;        // Last completed frame kept the previous pixels
+  bool output_valid;        // Output target holds the previous frame
+  bool output_changed;      // Target was replaced during this frame
+  uint16_t line_start;      // First pixel of the current line to output
+  uint64_t vram_hash;       // Content hash of nametables, palette and OAM
+  uint32_t chr_generation;  // Bumped when CHR-RAM data changes
+  uint32_t chr_signature;   // CHR banking as reported by the mapper
+  uint8_t mirroring;
+  uint64_t frame_start_fp[2]; // Input fingerprint: current, previous frame
+  uint32_t journal_pos[2][PPU_JOURNAL_SIZE];
+  uint64_t journal_hash[2][PPU_JOURNAL_SIZE];
+  int journal_len[2]; // -1 once a frame overflows the journal
+  uint8_t journal_cur;
+  int journal_match; // Entries of the previous journal matched so far
+
+  // Deferred Rendering
+  // The emulation thread only produces timing (as in frame-skip mode) and
+  // records each frame into a job; a render thread replays the job through
+  // its own copy of this state to produce the pixels.
+  bool deferred;           // Record frames for the render thread
+  PPU_FrameJob *defer_job; // Frame being recorded (lines 0-239)
+  bool replay;             // Replaying a job: no mapper or CPU side effects
 
   // OAM
   uint8_t oam[256];
@@ -67,25 +178,21 @@ typedef struct {
   uint16_t bg_shifter_attrib_lo;
   uint16_t bg_shifter_attrib_hi;
 
+  // Sprite Occupancy (rebuilt incrementally on OAM/$2000 writes)
+  // Bit i of sprite_line_mask[y] is set if OAM sprite i covers scanline y.
+  uint64_t sprite_line_mask[240];
+  uint8_t sprite_line_height; // Sprite height the masks were built with
+
   // Sprite Rendering State
   uint8_t secondary_oam[32]; // 8 sprites * 4 bytes
   uint8_t sprite_count;      // Number of sprites found on next scanline
-  uint8_t
-      render_sprite_count; // Number of sprites to render on current scanline
 
-  // Shifters for 8 sprites (Shift Registers)
-  // Using 8-bit shifts as sprites are 8-wide logic
-  uint8_t sprite_shifter_pattern_lo[8];
-  uint8_t sprite_shifter_pattern_hi[8];
-
-  // Counters and Attributes for 8 sprites
-  uint8_t sprite_attrib[8];    // Latched attributes for current line
-  uint8_t sprite_x_counter[8]; // X position counters
+  // Sprite pixels for the line being drawn, painted once at dot 320 of the
+  // previous line (see ppu_paint_sprite for the encoding)
+  uint8_t sprite_line_buffer[256];
 
   // Sprite 0 Detection
-  bool sprite_zero_hit_possible;    // True if Sprite 0 is in Secondary OAM
-  bool render_sprite_zero_possible; // Latched for rendering
-  bool sprite_zero_being_rendered;  // True if Sprite 0 is being rendered
+  bool sprite_zero_hit_possible; // True if Sprite 0 is in Secondary OAM
 
   uint8_t data_buffer; // PPUDATA read buffer
 
@@ -95,10 +202,48 @@ typedef struct {
   bool frame_complete;
 
   // Internal Mirrors
-  uint8_t nametables[2048]; // 2KB internal (Vertical/Horizontal mirroring)
+  // 2KB internal VRAM plus 2KB of cartridge VRAM used by four-screen boards
+  uint8_t nametables[4096];
+  // 1KB page backing each of $2000/$2400/$2800/$2C00, set by the mapper
+  uint8_t *nt_page[4];
+  // 2-bit palette index of every tile (32x32, including the attribute rows
+  // 30-31 a coarse Y of 30/31 reaches) for each physical nametable, kept in
+  // step with attribute byte writes, and the shadow behind each page
+  uint8_t attr_shadow[4][32 * 32];
+  uint8_t *at_page[4];
+
+  // Pattern Tables
+  // 1KB page backing each window of $0000-$1FFF, resolved from the mapper's
+  // banks whenever they change, so a pattern fetch is one table lookup
+  uint32_t chr_bank[8]; // Offset of each page into chr_data
+  uint8_t *chr_page[8];
+  uint8_t chr_writable; // Bit i set if page i is CHR-RAM (ROM is protected)
+  uint8_t *chr_data;    // CHR the pages point into (a replay uses its copy)
   ROM *rom;                 // Access to CHR ROM
 } PPU_State;
 
+typedef struct {
+  uint32_t pos; // scanline * 341 + dot, before that dot is processed
+  uint16_t addr;
+  uint8_t kind; // PPU_EVENT_*
+  uint8_t value;
+} PPU_Event;
+
+// One recorded frame: the PPU state at line 0, dot 0 plus every CPU-side
+// event that touched it during lines 0-239
+struct PPU_FrameJob {
+  PPU_State start;
+  uint8_t chr_ram[PPU_DEFER_CHR_RAM]; // CHR-RAM contents at the start
+  PPU_Event events[PPU_DEFER_EVENTS];
+  int event_count;
+  uint8_t dma[PPU_DEFER_DMA][256];
+  int dma_count;
+  uint32_t chr_banks[PPU_DEFER_CHR_BANKS][8];
+  int chr_bank_count;
+  bool overflow; // Events were dropped; the replay may be inexact
+  bool render;   // False for skipped frames: nothing to draw
+};
+
 void ppu_init(ROM *rom);
 void ppu_reset(void);
 void ppu_step(void);
@@ -108,10 +253,61 @@ uint8_t ppu_read_reg(uint16_t addr);
 void ppu_write_reg(uint16_t addr, uint8_t val);
 void ppu_dma(uint8_t *page_data);
 
+// Nametable Mirroring
+// Called by the mapper whenever its mirroring mode changes
+void ppu_set_mirroring(uint8_t mirroring);
+// Called by the mapper when its CHR banking may have changed, with the CHR
+// data offset of each 1KB page of $0000-$1FFF
+void ppu_set_chr_banks(const uint32_t pages[8]);
+
+// Video Output
+// The target must stay valid (e.g. a locked texture) until it is replaced
+void ppu_set_output(void *pixels, int pitch, uint8_t format);
+const PPU_OutputTarget *ppu_get_output(void);
+// Skip pixel generation from the next frame on. The request is latched as
+// VBlank begins (line 240), so a call made any time during frame N applies
+// to frame N+1 as a whole. VBlank/NMI, sprite 0 hit, overflow and mapper A12
+// timing stay exact.
+void ppu_set_frame_skip(bool skip);
+// Composite and output only columns [x0, x1) of lines [y0, y1) from the next
+// frame on, latched like the frame-skip flag; the default is the whole
+// 256x240 frame. Pixels outside are left untouched in the target, while
+// fetches, scrolling, sprite 0 hit and mapper A12 timing stay exact. A new
+// region is never served by frame reuse: that frame is rendered in full and
+// every row reported dirty.
+void ppu_set_render_region(int x0, int y0, int x1, int y1);
+// Position of the next frame's sprite 0 hit, assuming no further CPU writes
+// to PPU registers, OAM, VRAM or mapper banks. Works from VBlank until dot
+// 257 of the pre-render line; returns false if no hit will occur or the
+// PPU is past that point. Lets a caller schedule the $2002 change instead of
+// polling for it.
+bool ppu_predict_sprite0_hit(int *scanline, int *dot);
+// Reuse the previous frame's pixels while the inputs match (static screens).
+// The output target must keep its contents from one frame to the next.
+void ppu_set_frame_reuse(bool enable);
+// True if the last completed frame was left as the previous frame's pixels
+bool ppu_frame_was_reused(void);
+// Rows of the output target that changed in the last completed frame:
+// bit (y & 63) of word (y >> 6), 240 bits in 4 words
+const uint64_t *ppu_get_dirty_lines(void);
+// 64-bit hash of each output row (in the target's format), 240 entries
+const uint64_t *ppu_get_line_hashes(void);
+// Count per-frame statistics (off by default; costs a few branches)
+void ppu_set_stats(bool enable);
+// Statistics of the last completed frame
+const PPU_FrameStats *ppu_get_frame_stats(void);
+// Record frames into jobs for the render thread (see render_thread.h)
+// instead of drawing them. The emulation thread keeps exact timing.
+void ppu_set_deferred(bool enable);
+// Render thread: replay a recorded job into `output`. `line_hash` holds the
+// row hashes of what `output` contains and is updated. The job is consumed.
+void ppu_render_job(PPU_FrameJob *job, const PPU_OutputTarget *output,
+                    uint64_t *line_hash);
+
 // Debug/Display
-// Debug/Display
-const uint8_t *ppu_get_framebuffer(void);
 const uint8_t *ppu_get_palette(void);
+// Emphasis bits (PPUMASK >> 5) for each of the 240 lines of the framebuffer
+const uint8_t *ppu_get_emphasis(void);
 bool ppu_is_frame_complete(void);
 void ppu_clear_frame_complete(void);
 // Debug Access
@@ -0,0 +1,127 @@
+#include "ppu_view.h"
+#include "palette.h"
+#include "ppu.h"
+
+#define VIEW_OVERLAY_COLOR 0x16 // Red, for the scroll viewport
+
+static inline uint8_t view_chr(const PPU_State *p, uint16_t addr) {
+  return p->chr_page[addr >> 10][addr & 0x03FF];
+}
+
+// 2-bit pixel `col` (0 = leftmost) of a tile row
+static inline uint8_t view_tile_pixel(const PPU_State *p, uint16_t addr,
+                                      int col) {
+  uint8_t lo = view_chr(p, addr), hi = view_chr(p, addr + 8);
+  return (((hi >> (7 - col)) & 1) << 1) | ((lo >> (7 - col)) & 1);
+}
+
+// Palette RAM color for palette 0-7 and pixel 0-3; pixel 0 is the backdrop
+static inline uint8_t view_color(const PPU_State *p, int palette, int pix) {
+  return pix ? p->palette[(palette << 2) | pix] & 0x3F : p->palette[0] & 0x3F;
+}
+
+static inline void view_output_row(const uint8_t *row, void *pixels,
+                                   int pitch, int y, int width,
+                                   uint8_t format) {
+  palette_convert_line_to(row, (uint8_t *)pixels + (size_t)y * pitch, width,
+                          0, format);
+}
+
+void ppu_view_nametables(void *pixels, int pitch, uint8_t format) {
+  const PPU_State *p = ppu_get_state();
+  uint16_t bg_base = (p->ctrl & PPU_CTRL_BG_PT) ? 0x1000 : 0x0000;
+  uint8_t row[PPU_VIEW_NAMETABLES_WIDTH];
+
+  // Viewport origin from t: coarse/fine X and Y plus the nametable bits
+  int sx = (((p->t & 0x001F) << 3) | p->fine_x) + ((p->t & 0x0400) ? 256 : 0);
+  int sy = (((p->t >> 5) & 0x1F) << 3) + ((p->t >> 12) & 0x07) +
+           ((p->t & 0x0800) ? 240 : 0);
+  sy %= PPU_VIEW_NAMETABLES_HEIGHT;
+
+  for (int y = 0; y < PPU_VIEW_NAMETABLES_HEIGHT; y++) {
+    int ty = (y % 240) >> 3;
+    for (int x = 0; x < PPU_VIEW_NAMETABLES_WIDTH; x++) {
+      int nt = (y >= 240 ? 2 : 0) | (x >= 256 ? 1 : 0);
+      int cell = ty * 32 + ((x & 0xFF) >> 3);
+      uint8_t tile = p->nt_page[nt][cell];
+      uint8_t pix =
+          view_tile_pixel(p, bg_base + (tile << 4) + (y & 7), x & 7);
+      row[x] = view_color(p, p->at_page[nt][cell], pix);
+    }
+
+    // Viewport outline, wrapping around the 512x480 map like the scroll
+    int dy = (y - sy + PPU_VIEW_NAMETABLES_HEIGHT) % PPU_VIEW_NAMETABLES_HEIGHT;
+    if (dy == 0 || dy == 239) {
+      for (int i = 0; i < 256; i++)
+        row[(sx + i) % PPU_VIEW_NAMETABLES_WIDTH] = VIEW_OVERLAY_COLOR;
+    } else if (dy < 240) {
+      row[sx % PPU_VIEW_NAMETABLES_WIDTH] = VIEW_OVERLAY_COLOR;
+      row[(sx + 255) % PPU_VIEW_NAMETABLES_WIDTH] = VIEW_OVERLAY_COLOR;
+    }
+
+    view_output_row(row, pixels, pitch, y, PPU_VIEW_NAMETABLES_WIDTH, format);
+  }
+}
+
+void ppu_view_patterns(void *pixels, int pitch, uint8_t format, int palette) {
+  const PPU_State *p = ppu_get_state();
+  uint8_t row[PPU_VIEW_PATTERNS_WIDTH];
+  palette &= 0x07;
+
+  // 16x16 tiles per table; table 1 starts at x = 128
+  for (int y = 0; y < PPU_VIEW_PATTERNS_HEIGHT; y++) {
+    for (int x = 0; x < PPU_VIEW_PATTERNS_WIDTH; x++) {
+      uint16_t tile = ((x >> 7) << 8) | ((y >> 3) << 4) | ((x & 0x7F) >> 3);
+      row[x] = view_color(p, palette,
+                          view_tile_pixel(p, (tile << 4) | (y & 7), x & 7));
+    }
+    view_output_row(row, pixels, pitch, y, PPU_VIEW_PATTERNS_WIDTH, format);
+  }
+}
+
+void ppu_view_oam(void *pixels, int pitch, uint8_t format) {
+  const PPU_State *p = ppu_get_state();
+  bool tall = p->ctrl & PPU_CTRL_SPR_SIZE;
+  uint16_t spr_base = (p->ctrl & PPU_CTRL_SPR_PT) ? 0x1000 : 0x0000;
+  uint8_t row[PPU_VIEW_OAM_WIDTH];
+
+  for (int y = 0; y < PPU_VIEW_OAM_HEIGHT; y++) {
+    int r = y & 15;
+    for (int x = 0; x < PPU_VIEW_OAM_WIDTH; x++) {
+      const uint8_t *s = &p->oam[(((y >> 4) << 3) | (x >> 3)) * 4];
+      uint8_t tile = s[1], attr = s[2];
+      int height = tall ? 16 : 8;
+      if (r >= height) {
+        row[x] = view_color(p, 0, 0);
+        continue;
+      }
+
+      int sr = (attr & 0x80) ? height - 1 - r : r;
+      int col = (attr & 0x40) ? 7 - (x & 7) : (x & 7);
+      uint16_t addr;
+      if (!tall) {
+        addr = spr_base + (tile << 4) + sr;
+      } else {
+        addr = ((tile & 0x01) ? 0x1000 : 0x0000) +
+               (((tile & 0xFE) + (sr >= 8)) << 4) + (sr & 7);
+      }
+      row[x] = view_color(p, 4 | (attr & 0x03), view_tile_pixel(p, addr, col));
+    }
+    view_output_row(row, pixels, pitch, y, PPU_VIEW_OAM_WIDTH, format);
+  }
+}
+
+void ppu_view_palette(void *pixels, int pitch, uint8_t format) {
+  const PPU_State *p = ppu_get_state();
+  uint8_t row[PPU_VIEW_PALETTE_WIDTH];
+
+  for (int y = 0; y < PPU_VIEW_PALETTE_HEIGHT; y++) {
+    for (int x = 0; x < PPU_VIEW_PALETTE_WIDTH; x++) {
+      int i = ((y >> 3) << 4) | (x >> 3);
+      if ((i & 0x13) == 0x10)
+        i &= 0x0F; // $3F10/$3F14/$3F18/$3F1C mirror the BG entries
+      row[x] = p->palette[i] & 0x3F;
+    }
+    view_output_row(row, pixels, pitch, y, PPU_VIEW_PALETTE_WIDTH, format);
+  }
+}
@@ -0,0 +1,34 @@
+#ifndef PPU_VIEW_H
+#define PPU_VIEW_H
+
+#include <stdint.h>
+
+// Debug views of the PPU's memory, drawn into caller-owned buffers on
+// request. They read the PPU state as it is (call between frames) and cost
+// nothing while unused. `format` is a PALETTE_FORMAT_* value and `pitch`
+// the destination row size in bytes.
+
+// All four nametables ($2000 top left ... $2C00 bottom right) with the
+// 256x240 viewport that t and fine X scroll to outlined
+#define PPU_VIEW_NAMETABLES_WIDTH 512
+#define PPU_VIEW_NAMETABLES_HEIGHT 480
+void ppu_view_nametables(void *pixels, int pitch, uint8_t format);
+
+// Pattern tables $0000 and $1000 side by side, as currently banked, colored
+// with palette 0-3 (BG) or 4-7 (sprites)
+#define PPU_VIEW_PATTERNS_WIDTH 256
+#define PPU_VIEW_PATTERNS_HEIGHT 128
+void ppu_view_patterns(void *pixels, int pitch, uint8_t format, int palette);
+
+// The 64 OAM entries in OAM order, 8 per row, each in an 8x16 cell (8x8
+// sprites use the top half), flipped as they are displayed
+#define PPU_VIEW_OAM_WIDTH 64
+#define PPU_VIEW_OAM_HEIGHT 128
+void ppu_view_oam(void *pixels, int pitch, uint8_t format);
+
+// Palette RAM: BG entries on the top row, sprite entries below, 8x8 each
+#define PPU_VIEW_PALETTE_WIDTH 128
+#define PPU_VIEW_PALETTE_HEIGHT 16
+void ppu_view_palette(void *pixels, int pitch, uint8_t format);
+
+#endif // PPU_VIEW_H
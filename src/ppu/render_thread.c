@@ -0,0 +1,130 @@
+#include "render_thread.h"
+#include "framebuffer.h"
+#include <SDL2/SDL.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// One job is recorded while the other is drawn
+#define RENDER_JOBS 2
+
+static PPU_FrameJob *jobs[RENDER_JOBS];
+static SDL_Thread *thread = NULL;
+static SDL_mutex *lock = NULL;
+static SDL_cond *cond = NULL;
+static bool quit = false;
+
+// Jobs are used in order: begun by the PPU, handed over, then drawn
+static uint64_t jobs_begun;
+static uint64_t jobs_handed;
+static uint64_t jobs_drawn;
+
+// Render target, persistent so unchanged rows keep their hashes
+static uint32_t pixels[FRAME_WIDTH * FRAME_HEIGHT];
+static uint64_t line_hash[FRAME_HEIGHT];
+
+static int render_thread_main(void *data) {
+  (void)data;
+  const PPU_OutputTarget target = {pixels, FRAME_WIDTH * sizeof(uint32_t),
+                                   PALETTE_FORMAT_XRGB8888};
+  bool warned = false;
+
+  SDL_LockMutex(lock);
+  while (true) {
+    while (jobs_drawn == jobs_handed && !quit)
+      SDL_CondWait(cond, lock);
+    if (jobs_drawn == jobs_handed)
+      break;
+    PPU_FrameJob *job = jobs[jobs_drawn % RENDER_JOBS];
+    SDL_UnlockMutex(lock);
+
+    if (job->render) {
+      if (job->overflow && !warned) {
+        printf("[Render] Frame journal overflowed, output may be inexact\n");
+        warned = true;
+      }
+      ppu_render_job(job, &target, line_hash);
+      framebuffer_submit(pixels, target.pitch, line_hash);
+    }
+
+    SDL_LockMutex(lock);
+    jobs_drawn++;
+    SDL_CondBroadcast(cond);
+  }
+  SDL_UnlockMutex(lock);
+  return 0;
+}
+
+bool render_thread_start(void) {
+  for (int i = 0; i < RENDER_JOBS; i++) {
+    jobs[i] = malloc(sizeof(PPU_FrameJob));
+    if (!jobs[i]) {
+      printf("Failed to allocate render jobs\n");
+      render_thread_stop();
+      return false;
+    }
+  }
+  jobs_begun = jobs_handed = jobs_drawn = 0;
+  quit = false;
+
+  lock = SDL_CreateMutex();
+  cond = SDL_CreateCond();
+  if (lock && cond)
+    thread = SDL_CreateThread(render_thread_main, "render", NULL);
+  if (!thread) {
+    printf("Render thread creation failed: %s\n", SDL_GetError());
+    render_thread_stop();
+    return false;
+  }
+  printf("Render thread started\n");
+  return true;
+}
+
+void render_thread_stop(void) {
+  if (thread) {
+    SDL_LockMutex(lock);
+    quit = true;
+    SDL_CondBroadcast(cond);
+    SDL_UnlockMutex(lock);
+    SDL_WaitThread(thread, NULL);
+    thread = NULL;
+  }
+  if (cond) {
+    SDL_DestroyCond(cond);
+    cond = NULL;
+  }
+  if (lock) {
+    SDL_DestroyMutex(lock);
+    lock = NULL;
+  }
+  for (int i = 0; i < RENDER_JOBS; i++) {
+    free(jobs[i]);
+    jobs[i] = NULL;
+  }
+}
+
+void render_thread_flush(void) {
+  if (!thread)
+    return;
+  SDL_LockMutex(lock);
+  while (jobs_drawn < jobs_handed)
+    SDL_CondWait(cond, lock);
+  SDL_UnlockMutex(lock);
+}
+
+PPU_FrameJob *render_thread_begin_job(void) {
+  SDL_LockMutex(lock);
+  while (jobs_begun - jobs_drawn >= RENDER_JOBS)
+    SDL_CondWait(cond, lock);
+  PPU_FrameJob *job = jobs[jobs_begun % RENDER_JOBS];
+  jobs_begun++;
+  SDL_UnlockMutex(lock);
+  return job;
+}
+
+void render_thread_end_job(PPU_FrameJob *job, bool render) {
+  job->render = render;
+  SDL_LockMutex(lock);
+  jobs_handed++;
+  SDL_CondBroadcast(cond);
+  SDL_UnlockMutex(lock);
+}
@@ -0,0 +1,21 @@
+#ifndef RENDER_THREAD_H
+#define RENDER_THREAD_H
+
+#include "ppu.h"
+#include <stdbool.h>
+
+// Deferred PPU rendering on a second thread. The emulation thread records
+// each frame into a job (ppu_set_deferred); this thread replays the job to
+// draw the pixels and publishes them through framebuffer.h.
+
+bool render_thread_start(void);
+void render_thread_stop(void);
+// Wait until every handed-over job has been drawn (ROM changes, frame dump)
+void render_thread_flush(void);
+
+// Called by the PPU. begin waits only while the render thread is a full
+// frame behind; end hands the job over (render == false just frees it).
+PPU_FrameJob *render_thread_begin_job(void);
+void render_thread_end_job(PPU_FrameJob *job, bool render);
+
+#endif // RENDER_THREAD_H
@@ -0,0 +1,77 @@
+#include "timeline.h"
+#include "ppu.h"
+
+#define TIMELINE_MASK (TIMELINE_CAPACITY - 1)
+
+bool timeline_enabled = false;
+
+static Timeline_Event ring[TIMELINE_CAPACITY];
+static uint32_t head; // Next slot to write
+static uint32_t tail; // Next slot to read
+static uint32_t dropped;
+
+void timeline_enable(bool enable) {
+  timeline_enabled = enable;
+  head = tail = 0;
+  dropped = 0;
+}
+
+void timeline_push(uint8_t kind, uint8_t reg, uint8_t value) {
+  if (head - tail == TIMELINE_CAPACITY) {
+    dropped++;
+    return;
+  }
+  const PPU_State *p = ppu_get_state();
+  ring[head & TIMELINE_MASK] = (Timeline_Event){
+      .scanline = p->scanline, .dot = p->dot, .kind = kind, .reg = reg,
+      .value = value};
+  head++;
+}
+
+int timeline_read(Timeline_Event *out, int max) {
+  int count = 0;
+  while (tail != head && count < max)
+    out[count++] = ring[tail++ & TIMELINE_MASK];
+  return count;
+}
+
+uint32_t timeline_dropped(void) { return dropped; }
+
+static const uint32_t timeline_colors[8] = {
+    [TIMELINE_REG_WRITE] = 0xFFFFFF00,   // Yellow
+    [TIMELINE_STATUS_READ] = 0xFF00C0FF, // Cyan
+    [TIMELINE_OAM_DMA] = 0xFF00FF40,     // Green
+    [TIMELINE_NMI] = 0xFFFF40FF,         // Magenta
+    [TIMELINE_MAPPER_IRQ] = 0xFFFF2020,  // Red
+    [TIMELINE_DMC_FETCH] = 0xFFFF9000,   // Orange
+};
+
+void timeline_render(const Timeline_Event *events, int count,
+                     uint32_t *pixels, int pitch) {
+  for (int y = 0; y < TIMELINE_IMAGE_HEIGHT; y++) {
+    uint32_t *row = (uint32_t *)((uint8_t *)pixels + (size_t)y * pitch);
+    for (int x = 0; x < TIMELINE_IMAGE_WIDTH; x++) {
+      uint32_t bg;
+      if (y < 240)
+        bg = (x >= 1 && x <= 256) ? 0xFF303030 : 0xFF181818;
+      else if (y == 261)
+        bg = 0xFF242424;
+      else if (y >= 241)
+        bg = 0xFF101828; // VBlank
+      else
+        bg = 0xFF101010;
+      row[x] = bg;
+    }
+  }
+
+  for (int i = 0; i < count; i++) {
+    const Timeline_Event *ev = &events[i];
+    if (ev->kind == TIMELINE_FRAME || ev->kind >= 8 ||
+        ev->scanline >= TIMELINE_IMAGE_HEIGHT ||
+        ev->dot >= TIMELINE_IMAGE_WIDTH)
+      continue;
+    uint32_t *row =
+        (uint32_t *)((uint8_t *)pixels + (size_t)ev->scanline * pitch);
+    row[ev->dot] = timeline_colors[ev->kind];
+  }
+}
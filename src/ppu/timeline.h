@@ -0,0 +1,62 @@
+#ifndef TIMELINE_H
+#define TIMELINE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Raster event timeline: the (scanline, dot) of every PPU register write,
+// $2002 read, OAM DMA, NMI, mapper IRQ and DMC sample fetch, for spotting
+// mid-line writes and other raster effects. Events go into a ring buffer
+// that the emulation thread drains between frames; while disabled,
+// recording is a single flag test.
+
+#define TIMELINE_REG_WRITE 1   // reg = register 0-7, value = data
+#define TIMELINE_STATUS_READ 2 // value = status returned
+#define TIMELINE_OAM_DMA 3     // value = OAMADDR at the start
+#define TIMELINE_NMI 4
+#define TIMELINE_MAPPER_IRQ 5 // value = IRQ latch
+#define TIMELINE_DMC_FETCH 6  // value = sample byte
+#define TIMELINE_FRAME 7      // End of a frame (PPU wrapped to line 0)
+
+#define TIMELINE_CAPACITY 65536 // Events, power of two
+
+// Binary trace: TIMELINE_MAGIC, then one 8-byte little-endian record per
+// event, frames separated by TIMELINE_FRAME records
+#define TIMELINE_MAGIC "NESTLN01"
+
+typedef struct {
+  uint16_t scanline;
+  uint16_t dot;
+  uint8_t kind; // TIMELINE_*
+  uint8_t reg;
+  uint8_t value;
+  uint8_t reserved;
+} Timeline_Event;
+
+// Grid image produced by timeline_render: one pixel per dot
+#define TIMELINE_IMAGE_WIDTH 341
+#define TIMELINE_IMAGE_HEIGHT 262
+
+extern bool timeline_enabled;
+
+void timeline_enable(bool enable);
+void timeline_push(uint8_t kind, uint8_t reg, uint8_t value);
+
+// Record an event at the PPU's current position
+static inline void timeline_record(uint8_t kind, uint8_t reg, uint8_t value) {
+  if (timeline_enabled)
+    timeline_push(kind, reg, value);
+}
+
+// Move up to `max` recorded events into `out`, oldest first; returns the
+// count. Events that did not fit in the ring are counted by
+// timeline_dropped().
+int timeline_read(Timeline_Event *out, int max);
+uint32_t timeline_dropped(void);
+
+// Draw events over a 341x262 map of the frame (visible area, HBlank,
+// VBlank and pre-render line shaded differently) as XRGB8888
+void timeline_render(const Timeline_Event *events, int count,
+                     uint32_t *pixels, int pitch);
+
+#endif // TIMELINE_H
@@ -1,5 +1,6 @@
 #include "mapper.h"
 #include "../ppu/ppu.h"
+#include "../ppu/timeline.h"
 #include "cpu.h"
 #include <stdio.h>
 #include <string.h>
@@ -45,6 +46,11 @@ static uint8_t uxrom_prg_bank = 0;
 // --- Mapper 3 (CNROM) State ---
 static uint8_t cnrom_chr_bank = 0;
 
+// Push the current mirroring mode to the PPU's nametable page table
+static void mapper_sync_mirroring(void) {
+  ppu_set_mirroring(mapper_get_mirroring());
+}
+
 // --- Mapper 0 (NROM) Logic ---
 
 static uint8_t nrom_cpu_read(uint16_t addr) {
@@ -71,19 +77,6 @@ static void nrom_cpu_write(uint16_t addr, uint8_t val) {
   }
 }
 
-static uint8_t nrom_ppu_read(uint16_t addr) {
-  if (addr < 0x2000 && ctx_rom->chr_data) {
-    return ctx_rom->chr_data[addr % ctx_rom->chr_size];
-  }
-  return 0;
-}
-
-static void nrom_ppu_write(uint16_t addr, uint8_t val) {
-  if (addr < 0x2000 && ctx_rom->is_chr_ram && ctx_rom->chr_data) {
-    ctx_rom->chr_data[addr % ctx_rom->chr_size] = val;
-  }
-}
-
 // --- Mapper 1 (MMC1) Logic ---
 
 static void mmc1_reset(void) {
@@ -116,6 +109,7 @@ static void mmc1_update_regs(uint16_t addr, uint8_t val) {
 
     if (reg == 0x0000) { // Control $8000-$9FFF
       mmc1.control = data;
+      mapper_sync_mirroring();
     } else if (reg == 0x2000) { // CHR0 $A000-$BFFF
       mmc1.chr_bank0 = data;
     } else if (reg == 0x4000) { // CHR1 $C000-$DFFF
@@ -264,21 +258,6 @@ static uint32_t mmc1_get_chr_addr(uint16_t addr) {
   }
 }
 
-static uint8_t mmc1_ppu_read(uint16_t addr) {
-  if (addr < 0x2000 && ctx_rom->chr_data) {
-    uint32_t phys = mmc1_get_chr_addr(addr);
-    return ctx_rom->chr_data[phys % ctx_rom->chr_size];
-  }
-  return 0;
-}
-
-static void mmc1_ppu_write(uint16_t addr, uint8_t val) {
-  if (addr < 0x2000 && ctx_rom->is_chr_ram && ctx_rom->chr_data) {
-    uint32_t phys = mmc1_get_chr_addr(addr);
-    ctx_rom->chr_data[phys % ctx_rom->chr_size] = val;
-  }
-}
-
 static uint8_t mmc1_get_mirroring(void) {
   uint8_t m = mmc1.control & 3;
   switch (m) {
@@ -388,6 +367,7 @@ static void mmc3_cpu_write(uint16_t addr, uint8_t val) {
   } else if (addr >= 0xA000 && addr <= 0xBFFF) {
     if (even) { // $A000 Mirroring
       mmc3.mirroring = val;
+      mapper_sync_mirroring();
       printf("MMC3 Mirroring Write: %02X (Mode: %s)\n", val,
              (val & 1) ? "Horizontal" : "Vertical");
     } else { // $A001 RAM Protect
@@ -475,6 +455,7 @@ static void mmc3_clock_irq(void) {
   if (mmc3.irq_counter == 0 && mmc3.irq_enabled) {
     // printf("MMC3 IRQ Fired! Scanline: %d Frame: %d Ctr: %d\n",
     //        ppu_get_scanline(), 0, mmc3.irq_counter); // TODO: Frame
+    timeline_record(TIMELINE_MAPPER_IRQ, 0, mmc3.irq_latch);
     cpu_irq();
   }
 }
@@ -488,6 +469,9 @@ void mapper_ppu_tick(uint16_t addr) {
 
   // Nametable fetches ($2xxx, A12=0) also count as Low!
 
+  if (!ctx_rom || ctx_rom->mapper_id != 4)
+    return; // Only MMC3 watches A12
+
   if ((addr & 0x1000) == 0) {
     mmc3.a12_low_count++;
   } else {
@@ -498,22 +482,14 @@ void mapper_ppu_tick(uint16_t addr) {
   }
 }
 
-static uint8_t mmc3_ppu_read(uint16_t addr) {
-  // mmc3_check_a12(addr); // Moved to global tick
-
-  if (addr < 0x2000 && ctx_rom->chr_data) {
-    uint32_t phys = mmc3_get_chr_addr(addr);
-    return ctx_rom->chr_data[phys % ctx_rom->chr_size];
-  }
-  return 0;
-}
-
-static void mmc3_ppu_write(uint16_t addr, uint8_t val) {
-  // mmc3_check_a12(addr); // Moved to global tick
-
-  if (addr < 0x2000 && ctx_rom->is_chr_ram && ctx_rom->chr_data) {
-    uint32_t phys = mmc3_get_chr_addr(addr);
-    ctx_rom->chr_data[phys % ctx_rom->chr_size] = val;
+void mapper_ppu_tick_repeat(uint16_t addr, int count) {
+  if (count <= 0 || !ctx_rom || ctx_rom->mapper_id != 4)
+    return;
+  if ((addr & 0x1000) == 0) {
+    mmc3.a12_low_count += count;
+  } else {
+    // Only the first rise can clock; the rest see A12 already high
+    mapper_ppu_tick(addr);
   }
 }
 
@@ -563,20 +539,6 @@ static void uxrom_cpu_write(uint16_t addr, uint8_t val) {
   }
 }
 
-static uint8_t uxrom_ppu_read(uint16_t addr) {
-  // Uses CHR-RAM, standard mapping
-  if (addr < 0x2000 && ctx_rom->chr_data) {
-    return ctx_rom->chr_data[addr % ctx_rom->chr_size];
-  }
-  return 0;
-}
-
-static void uxrom_ppu_write(uint16_t addr, uint8_t val) {
-  if (addr < 0x2000 && ctx_rom->is_chr_ram && ctx_rom->chr_data) {
-    ctx_rom->chr_data[addr % ctx_rom->chr_size] = val;
-  }
-}
-
 // --- Mapper 3 (CNROM) Logic ---
 
 static void cnrom_reset(void) {
@@ -607,26 +569,25 @@ static void cnrom_cpu_write(uint16_t addr, uint8_t val) {
   }
 }
 
-static uint8_t cnrom_ppu_read(uint16_t addr) {
-  if (addr < 0x2000 && ctx_rom->chr_data) {
-    // 8KB Banked CHR
-    uint32_t bank = cnrom_chr_bank;
-    uint32_t offset = addr & 0x1FFF; // 8KB window
-    uint32_t phys = (bank * 8192) + offset;
-    return ctx_rom->chr_data[phys % ctx_rom->chr_size];
-  }
-  return 0;
+// Physical CHR address for a PPU pattern address under the current banking
+static uint32_t mapper_get_chr_addr(uint16_t addr) {
+  if (ctx_rom->mapper_id == 1)
+    return mmc1_get_chr_addr(addr);
+  if (ctx_rom->mapper_id == 4)
+    return mmc3_get_chr_addr(addr);
+  if (ctx_rom->mapper_id == 3)
+    return (cnrom_chr_bank * 8192) + (addr & 0x1FFF);
+  return addr;
 }
 
-static void cnrom_ppu_write(uint16_t addr, uint8_t val) {
-  // Usually CNROM uses CHR-ROM, so not writable.
-  // But if CHR-RAM is used (unlikely for standard CNROM?), we map it same way.
-  if (addr < 0x2000 && ctx_rom->is_chr_ram && ctx_rom->chr_data) {
-    uint32_t bank = cnrom_chr_bank;
-    uint32_t offset = addr & 0x1FFF;
-    uint32_t phys = (bank * 8192) + offset;
-    ctx_rom->chr_data[phys % ctx_rom->chr_size] = val;
+// Tell the PPU where each 1KB CHR page is mapped, as an offset into CHR data
+static void mapper_sync_chr(void) {
+  uint32_t pages[8];
+  for (int i = 0; i < 8; i++) {
+    uint32_t phys = mapper_get_chr_addr(i * 0x400);
+    pages[i] = ctx_rom->chr_size ? phys % ctx_rom->chr_size : 0;
   }
+  ppu_set_chr_banks(pages);
 }
 
 void mapper_init(ROM *rom) {
@@ -647,6 +608,8 @@ void mapper_init(ROM *rom) {
   } else {
     printf("Mapper %d Initialized (NROM)\n", rom->mapper_id);
   }
+  mapper_sync_mirroring();
+  mapper_sync_chr();
 }
 
 uint8_t mapper_cpu_read(uint16_t addr) {
@@ -678,42 +641,18 @@ void mapper_cpu_write(uint16_t addr, uint8_t val) {
     uxrom_cpu_write(addr, val);
   if (ctx_rom->mapper_id == 3)
     cnrom_cpu_write(addr, val);
-}
-
-uint8_t mapper_ppu_read(uint16_t addr) {
-  if (!ctx_rom)
-    return 0;
-  if (ctx_rom->mapper_id == 0)
-    return nrom_ppu_read(addr);
-  if (ctx_rom->mapper_id == 1)
-    return mmc1_ppu_read(addr);
-  if (ctx_rom->mapper_id == 4)
-    return mmc3_ppu_read(addr);
-  if (ctx_rom->mapper_id == 2)
-    return uxrom_ppu_read(addr);
-  if (ctx_rom->mapper_id == 3)
-    return cnrom_ppu_read(addr);
-  return 0;
-}
 
-void mapper_ppu_write(uint16_t addr, uint8_t val) {
-  if (!ctx_rom)
-    return;
-  if (ctx_rom->mapper_id == 0)
-    nrom_ppu_write(addr, val);
-  if (ctx_rom->mapper_id == 1)
-    mmc1_ppu_write(addr, val);
-  if (ctx_rom->mapper_id == 4)
-    mmc3_ppu_write(addr, val);
-  if (ctx_rom->mapper_id == 2)
-    uxrom_ppu_write(addr, val);
-  if (ctx_rom->mapper_id == 3)
-    cnrom_ppu_write(addr, val);
+  // Bank registers live at $8000-$FFFF
+  if (addr >= 0x8000)
+    mapper_sync_chr();
 }
 
 uint8_t mapper_get_mirroring(void) {
   if (!ctx_rom)
     return MIRRORING_VERTICAL;
+  // Four-screen boards carry their own VRAM and ignore mapper mirroring
+  if (ctx_rom->mirroring == MIRRORING_FOUR_SCREEN)
+    return MIRRORING_FOUR_SCREEN;
   if (ctx_rom->mapper_id == 0)
     return ctx_rom->mirroring;
   if (ctx_rom->mapper_id == 1)
@@ -11,15 +11,13 @@ void mapper_init(ROM *rom);
 uint8_t mapper_cpu_read(uint16_t addr);
 void mapper_cpu_write(uint16_t addr, uint8_t val);
 
-// PPU Read/Write (CHR-ROM, CHR-RAM)
-uint8_t mapper_ppu_read(uint16_t addr);
-void mapper_ppu_write(uint16_t addr, uint8_t val);
-
 // Get current mirroring mode
 // Returns: MIRRORING_HORIZONTAL, MIRRORING_VERTICAL, or others
 uint8_t mapper_get_mirroring(void);
 
 // Snoop PPU bus address for IRQ counters (MMC3)
 void mapper_ppu_tick(uint16_t addr);
+// Same as `count` consecutive mapper_ppu_tick(addr) calls
+void mapper_ppu_tick_repeat(uint16_t addr, int count);
 
 #endif // MAPPER_H
@@ -130,8 +130,9 @@ ROM *rom_load(const char *path) {
       printf("%02X ", rom->chr_data[k]);
     printf("\n");
   }
-  printf("  Mirroring: %s\n",
-         mirroring == MIRRORING_VERTICAL ? "Vertical" : "Horizontal");
+  printf("  Mirroring: %s\n", mirroring == MIRRORING_FOUR_SCREEN ? "Four-Screen"
+                             : mirroring == MIRRORING_VERTICAL ? "Vertical"
+                                                               : "Horizontal");
 
   return rom;
 }
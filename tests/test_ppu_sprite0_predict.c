@@ -0,0 +1,107 @@
+// tests/test_ppu_sprite0_predict.c
+// Sprite 0 hit prediction: on randomized frames, the line and dot
+// ppu_predict_sprite0_hit() reports from VBlank must match where the PPU
+// then sets the flag while rendering the next frame.
+//
+// Build from the repository root:
+//   cc -std=gnu11 -Isrc -Isrc/ppu -Isrc/rom -Isrc/cpu
+//      tests/test_ppu_sprite0_predict.c src/ppu/ppu.c src/ppu/palette.c
+//      src/ppu/timeline.c src/rom/mapper.c
+#include "../src/ppu/ppu.h"
+#include "../src/ppu/render_thread.h"
+#include "../src/rom/mapper.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Stubs: no CPU, no render thread
+void cpu_irq(void) {}
+void cpu_nmi(void) {}
+void cpu_clear_irq(void) {}
+void cpu_stall(int cycles) { (void)cycles; }
+PPU_FrameJob *render_thread_begin_job(void) { return NULL; }
+void render_thread_end_job(PPU_FrameJob *job, bool render) {
+  (void)job;
+  (void)render;
+}
+
+static void step_to(int scanline, int dot) {
+  for (int i = 0; i < 341 * 262 * 2; i++) {
+    const PPU_State *p = ppu_get_state();
+    if (p->scanline == scanline && p->dot == dot)
+      return;
+    ppu_step();
+  }
+  printf("FAIL: never reached line %d dot %d\n", scanline, dot);
+  exit(1);
+}
+
+int main() {
+  printf("Running Sprite 0 Hit Prediction Test...\n");
+
+  ROM rom;
+  memset(&rom, 0, sizeof(rom));
+  rom.mapper_id = 0;
+  rom.mirroring = MIRRORING_VERTICAL;
+  rom.prg_size = 32768;
+  rom.prg_data = calloc(1, rom.prg_size);
+  rom.chr_size = 8192;
+  rom.chr_data = malloc(rom.chr_size);
+
+  // Sparse patterns, so hits land anywhere in the sprite and some miss
+  srand(42);
+  for (int i = 0; i < rom.chr_size; i++)
+    rom.chr_data[i] = rand() & rand() & rand();
+
+  mapper_init(&rom);
+  ppu_init(&rom);
+  ppu_reset();
+  ppu_set_stats(true);
+
+  ppu_write_reg(0x2006, 0x20);
+  ppu_write_reg(0x2006, 0x00);
+  for (int i = 0; i < 2048; i++)
+    ppu_write_reg(0x2007, rand());
+
+  int frames = 500, hits = 0;
+  for (int f = 0; f < frames; f++) {
+    step_to(241, 10);
+
+    // Scroll, pattern tables, sprite size, left-column clipping and
+    // sprite 0 all change from frame to frame
+    ppu_write_reg(0x2000, rand() & 0x3B);
+    ppu_write_reg(0x2001, 0x18 | (rand() & 0x06));
+    (void)ppu_read_reg(0x2002);
+    ppu_write_reg(0x2005, rand());
+    ppu_write_reg(0x2005, rand() % 240);
+    ppu_write_reg(0x2003, 0x00);
+    ppu_write_reg(0x2004, rand() % 240);
+    for (int i = 0; i < 3; i++)
+      ppu_write_reg(0x2004, rand());
+
+    int line = -1, dot = -1;
+    bool predicted = ppu_predict_sprite0_hit(&line, &dot);
+
+    step_to(240, 0);
+    const PPU_FrameStats *stats = &ppu_get_state()->stats;
+    bool hit = stats->sprite0_line >= 0;
+    if (predicted != hit || (hit && (line != stats->sprite0_line ||
+                                     dot != stats->sprite0_dot))) {
+      printf("FAIL: frame %d predicted %s at line %d dot %d, hit %s at line "
+             "%d dot %d\n",
+             f, predicted ? "hit" : "none", line, dot, hit ? "set" : "none",
+             stats->sprite0_line, stats->sprite0_dot);
+      return 1;
+    }
+    hits += hit;
+  }
+
+  printf("%d of %d frames hit\n", hits, frames);
+  if (hits == 0 || hits == frames) {
+    printf("FAIL: expected both hits and misses\n");
+    return 1;
+  }
+
+  printf("Sprite 0 hit prediction test passed\n");
+  return 0;
+}